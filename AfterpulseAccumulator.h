@@ -0,0 +1,196 @@
+//AfterpulseAccumulator measures the afterpulsing of the 12 PMTs in the time-ordered event loop of MichelSpectrumwithCuts.
+//A primary is a large pulse of a PMT (area above largePE x mu1). Afterpulses are looked for
+//  - in the same event: local maxima above baselineMean + nSigma x baselineRMS in the samples after the primary pulse has ended,
+//    delay in ns from the peak of the primary (at most 44 samples = 704 ns),
+//  - in the following events: a small pulse (area between minPE and maxPE x mu1, not an LED event) of the same PMT up to window ns
+//    after a primary. Accidental pairs are measured in the same way with the primaries window to 2 x window ns earlier (off time),
+//    so the afterpulse count is on time - off time.
+//Pulse times are nsTime plus the time of the largest sample, as in timeDistributionMuonMichel. The memory does not grow with the
+//run: fixed histograms and, per PMT, the primaries of the last 2 x window ns (at most maxBuffered, older ones are dropped and
+//counted). Feed every entry in time order with Fill(); the afterpulse probability is per primary.
+#ifndef AFTERPULSEACCUMULATOR_H
+#define AFTERPULSEACCUMULATOR_H
+
+#include <TH1F.h>
+#include <TDirectory.h>
+#include <TVectorD.h>
+#include <TString.h>
+#include <TParameter.h>
+#include "DetectorGeometry.h"
+#include <deque>
+#include <algorithm>
+#include <cmath>
+
+class AfterpulseAccumulator {
+public:
+    double largePE = 20;         // Primary: area above largePE x mu1
+    double minPE = 0.5, maxPE = 5; // Small pulse in a following event
+    double nSigma = 5;           // In-event afterpulse threshold in baseline RMS
+    const double window;         // Cross-event delay range in ns
+    size_t maxBuffered = 4096;   // Primaries kept per PMT
+
+    // Counters per PMT (physical index)
+    Long64_t nPrimaries[kNumPMTs] = {0};
+    Long64_t nInEvent[kNumPMTs] = {0};    // In-event afterpulses
+    Long64_t nOnTime[kNumPMTs] = {0};     // Small pulses 0 - window after a primary
+    Long64_t nOffTime[kNumPMTs] = {0};    // Small pulses window - 2 x window after a primary
+    Long64_t nDropped[kNumPMTs] = {0};    // Primaries dropped from a full buffer
+    // PMT-trigger events with and without a primary up to window ns earlier, split by the Michel cuts
+    Long64_t nTriggerAfterPrimary[2] = {0}, nTriggerClean[2] = {0}; // [rejected, accepted]
+
+    TH1F *inEventDelay[kNumPMTs], *onTimeDelay[kNumPMTs], *offTimeDelay[kNumPMTs];
+
+    explicit AfterpulseAccumulator(double windowNs = 20000) : window(windowNs) {
+        for (int p = 0; p < kNumPMTs; p++) {
+            int n = kDetector[p].number;
+            inEventDelay[p] = new TH1F(Form("AP_PMT%d_inEvent", n), Form("PMT %d in-event afterpulses;Delay [ns];Afterpulses", n), 44, 8, 712);
+            onTimeDelay[p] = new TH1F(Form("AP_PMT%d_onTime", n), Form("PMT %d small pulses after a primary;Delay [ns];Pulses", n), 100, 0, window);
+            offTimeDelay[p] = new TH1F(Form("AP_PMT%d_offTime", n), Form("PMT %d accidental pairs;Delay [ns];Pulses", n), 100, 0, window);
+            TH1F *hists[3] = {inEventDelay[p], onTimeDelay[p], offTimeDelay[p]};
+            for (int h = 0; h < 3; h++) hists[h]->SetDirectory(0);
+        }
+    }
+
+    ~AfterpulseAccumulator() {
+        for (int p = 0; p < kNumPMTs; p++) {
+            delete inEventDelay[p];
+            delete onTimeDelay[p];
+            delete offTimeDelay[p];
+        }
+    }
+
+    AfterpulseAccumulator(const AfterpulseAccumulator &) = delete;
+    AfterpulseAccumulator &operator=(const AfterpulseAccumulator &) = delete;
+
+    // One entry of the run, in nsTime order; mu1 are the SPE gains of the PMTs (physical index)
+    void Fill(Long64_t nsTime, Int_t triggerBits, const Short_t (&adcVal)[23][45], const Double_t *area,
+              const Double_t *baselineMean, const Double_t *baselineRMS, const Double_t *mu1) {
+        if (fTimeOrigin < 0) fTimeOrigin = nsTime;
+        ForEachChannel<kPMTChannel>([&](int p) {
+            if (mu1[p] <= 0) return;
+            int ch = HardwareChannel(p);
+            const Short_t *samples = adcVal[ch];
+            int peak = std::max_element(samples, samples + 45) - samples;
+            double pulseTime = RunTime(nsTime) + (peak + 1) * 16.0;
+            std::deque<double> &primaries = fPrimaries[p];
+            while (!primaries.empty() && primaries.front() < pulseTime - 2 * window) primaries.pop_front();
+
+            if (area[ch] > largePE * mu1[p]) {
+                nPrimaries[p]++;
+                fillInEvent(p, samples, peak, baselineMean[ch] + std::max(nSigma * baselineRMS[ch], 3.0));
+                if (primaries.size() >= maxBuffered) {
+                    primaries.pop_front();
+                    nDropped[p]++;
+                }
+                // Peak times shift the order by less than one waveform; insert from the back
+                primaries.insert(std::upper_bound(primaries.begin(), primaries.end(), pulseTime), pulseTime);
+            } else if (!(triggerBits & 16) && area[ch] > minPE * mu1[p] && area[ch] <= maxPE * mu1[p]) {
+                nOnTime[p] += fillPairs(onTimeDelay[p], primaries, pulseTime, 0);
+                nOffTime[p] += fillPairs(offTimeDelay[p], primaries, pulseTime, window);
+            }
+        });
+    }
+
+    // Whether a PMT had a primary up to window ns before nsTime; call after Fill() of the event
+    bool FollowsPrimary(Long64_t nsTime) const {
+        double time = RunTime(nsTime);
+        for (int p = 0; p < kNumPMTs; p++) {
+            std::deque<double>::const_iterator first = std::lower_bound(fPrimaries[p].begin(), fPrimaries[p].end(), time - window);
+            if (first != fPrimaries[p].end() && *first < time) return true;
+        }
+        return false;
+    }
+
+    // Record the Michel selection of a PMT-trigger event
+    void CountSelection(Long64_t nsTime, bool accepted) {
+        if (FollowsPrimary(nsTime)) nTriggerAfterPrimary[accepted]++;
+        else nTriggerClean[accepted]++;
+    }
+
+    // Afterpulses per primary and their statistical uncertainty
+    double InEventProbability(int p) const { return nPrimaries[p] ? (double)nInEvent[p] / nPrimaries[p] : 0; }
+    double InEventError(int p) const { return nPrimaries[p] ? sqrt((double)nInEvent[p]) / nPrimaries[p] : 0; }
+    double CrossEventProbability(int p) const { return nPrimaries[p] ? (double)(nOnTime[p] - nOffTime[p]) / nPrimaries[p] : 0; }
+    double CrossEventError(int p) const { return nPrimaries[p] ? sqrt((double)(nOnTime[p] + nOffTime[p])) / nPrimaries[p] : 0; }
+
+    // Histograms, counters and the primary buffers (to resume the event loop) into the current directory
+    void Write() const {
+        TVectorD counters(kNumPMTs * 5 + 4);
+        for (int p = 0; p < kNumPMTs; p++) {
+            inEventDelay[p]->Write();
+            onTimeDelay[p]->Write();
+            offTimeDelay[p]->Write();
+            Long64_t values[5] = {nPrimaries[p], nInEvent[p], nOnTime[p], nOffTime[p], nDropped[p]};
+            for (int v = 0; v < 5; v++) counters[p * 5 + v] = values[v];
+            TVectorD buffer(std::max<int>(fPrimaries[p].size(), 1));
+            for (size_t i = 0; i < fPrimaries[p].size(); i++) buffer[i] = fPrimaries[p][i];
+            if (fPrimaries[p].empty()) buffer[0] = -1;
+            buffer.Write(Form("AP_PMT%d_buffer", kDetector[p].number));
+        }
+        for (int a = 0; a < 2; a++) {
+            counters[kNumPMTs * 5 + a] = nTriggerAfterPrimary[a];
+            counters[kNumPMTs * 5 + 2 + a] = nTriggerClean[a];
+        }
+        counters.Write("afterpulseCounters");
+        TParameter<Long64_t>("afterpulseTimeOrigin", fTimeOrigin).Write();
+    }
+
+    // Restore the state written by Write(); false if the directory holds no afterpulse state
+    bool Read(TDirectory *dir) {
+        TVectorD *counters = (TVectorD*)dir->Get("afterpulseCounters");
+        TParameter<Long64_t> *origin = (TParameter<Long64_t>*)dir->Get("afterpulseTimeOrigin");
+        if (!counters || !origin || counters->GetNrows() != kNumPMTs * 5 + 4) return false;
+        fTimeOrigin = origin->GetVal();
+        for (int p = 0; p < kNumPMTs; p++) {
+            int n = kDetector[p].number;
+            TH1F *saved[3] = {(TH1F*)dir->Get(Form("AP_PMT%d_inEvent", n)), (TH1F*)dir->Get(Form("AP_PMT%d_onTime", n)),
+                              (TH1F*)dir->Get(Form("AP_PMT%d_offTime", n))};
+            TH1F *hists[3] = {inEventDelay[p], onTimeDelay[p], offTimeDelay[p]};
+            for (int h = 0; h < 3; h++) {
+                hists[h]->Reset();
+                if (saved[h]) hists[h]->Add(saved[h]);
+            }
+            Long64_t *values[5] = {&nPrimaries[p], &nInEvent[p], &nOnTime[p], &nOffTime[p], &nDropped[p]};
+            for (int v = 0; v < 5; v++) *values[v] = (Long64_t)(*counters)[p * 5 + v];
+            fPrimaries[p].clear();
+            TVectorD *buffer = (TVectorD*)dir->Get(Form("AP_PMT%d_buffer", n));
+            for (int i = 0; buffer && i < buffer->GetNrows(); i++) {
+                if ((*buffer)[i] >= 0) fPrimaries[p].push_back((*buffer)[i]);
+            }
+        }
+        for (int a = 0; a < 2; a++) {
+            nTriggerAfterPrimary[a] = (Long64_t)(*counters)[kNumPMTs * 5 + a];
+            nTriggerClean[a] = (Long64_t)(*counters)[kNumPMTs * 5 + 2 + a];
+        }
+        return true;
+    }
+
+private:
+    std::deque<double> fPrimaries[kNumPMTs]; // Times of the recent primaries, increasing
+    Long64_t fTimeOrigin = -1;               // nsTime of the first entry: times are kept relative to it, exact in a double
+
+    double RunTime(Long64_t nsTime) const { return (double)(nsTime - fTimeOrigin); }
+
+    // Local maxima above threshold after the primary pulse has dropped below it
+    void fillInEvent(int p, const Short_t *samples, int peak, double threshold) {
+        int k = peak + 1;
+        while (k < 45 && samples[k] > threshold) k++;
+        for (; k < 45; k++) {
+            if (samples[k] <= threshold) continue;
+            if (k + 1 < 45 && samples[k + 1] > samples[k]) continue; // Still rising
+            inEventDelay[p]->Fill((k - peak) * 16.0);
+            nInEvent[p]++;
+            while (k + 1 < 45 && samples[k + 1] > threshold) k++;
+        }
+    }
+
+    // Fill the delays to the primaries in [time - shift - window, time - shift); returns their number
+    Long64_t fillPairs(TH1F *hist, const std::deque<double> &primaries, double time, double shift) {
+        std::deque<double>::const_iterator first = std::lower_bound(primaries.begin(), primaries.end(), time - shift - window);
+        std::deque<double>::const_iterator last = std::lower_bound(first, primaries.end(), time - shift);
+        for (std::deque<double>::const_iterator t = first; t != last; ++t) hist->Fill(time - *t - shift);
+        return last - first;
+    }
+};
+
+#endif
@@ -0,0 +1,179 @@
+//DerivedColumns defines per-event quantities computed from the branches of the run tree (peakPositionRMS, totalPE, max ADC...)
+//once, by name. A column is only computed when it is asked for, and its value is memoized for the entries of the current block,
+//so a quantity used in several places of a job is computed once per entry. Columns can also be written to a friend tree
+//and read back from it instead of being recomputed.
+//
+//    DerivedColumns columns;
+//    DefineRunColumns(columns, adcVal, area, peakPosition, mu1);
+//    int totalPE = columns.Find("totalPE");
+//    for (...) {
+//        tree->GetEntry(entry);
+//        columns.SetEntry(entry);                  // after every GetEntry: the formulas read the branch buffers
+//        if (columns.Get(totalPE) > 100) ...
+//    }
+//
+//The formulas capture the branch buffers by reference, so they must stay valid as long as the columns are used.
+#ifndef DERIVEDCOLUMNS_H
+#define DERIVEDCOLUMNS_H
+
+#include <TTree.h>
+#include <TBranch.h>
+#include "DetectorGeometry.h"
+#include <functional>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+class DerivedColumns {
+public:
+    typedef std::function<double()> Formula;
+
+    explicit DerivedColumns(int blockSize = 4096) : fBlockSize(blockSize), fBlockStart(-1), fEntry(-1) {}
+
+    // Define (or redefine) a column; returns its index for Get()
+    int Define(const char *name, Formula formula) {
+        int id = Find(name);
+        if (id < 0) {
+            id = fColumns.size();
+            fColumns.push_back(Column());
+            fColumns[id].name = name;
+            fIndex[name] = id;
+            fValues.resize(fColumns.size() * fBlockSize);
+            fDone.resize(fColumns.size() * fBlockSize, 0);
+        }
+        fColumns[id].formula = formula;
+        fBlockStart = -1;
+        return id;
+    }
+
+    // Another name for an existing column (e.g. the old branch name peakPosition_rms)
+    void Alias(const char *alias, const char *name) {
+        int id = Find(name);
+        if (id >= 0) fIndex[alias] = id;
+    }
+
+    int Find(const char *name) const {
+        std::map<std::string, int>::const_iterator it = fIndex.find(name);
+        return (it == fIndex.end()) ? -1 : it->second;
+    }
+
+    // Move to an entry; values memoized for other entries of the same block are kept
+    void SetEntry(Long64_t entry) {
+        fEntry = entry;
+        if (fBlockStart < 0 || entry < fBlockStart || entry >= fBlockStart + fBlockSize) {
+            fBlockStart = entry - entry % fBlockSize;
+            std::fill(fDone.begin(), fDone.end(), 0);
+        }
+    }
+
+    double Get(int id) {
+        size_t slot = (size_t)id * fBlockSize + (fEntry - fBlockStart);
+        if (!fDone[slot]) {
+            fValues[slot] = Evaluate(id);
+            fDone[slot] = 1;
+        }
+        return fValues[slot];
+    }
+
+    double Get(const char *name) { return Get(Find(name)); }
+
+    // Persisting: one double branch per column in a friend tree with one entry per entry of the run tree
+    TTree *MakeFriendTree(const char *treeName, const std::vector<std::string> &names) {
+        TTree *friendTree = new TTree(treeName, "Derived columns");
+        fPersisted.clear();
+        for (size_t i = 0; i < names.size(); i++) {
+            int id = Find(names[i].c_str());
+            if (id < 0) continue;
+            friendTree->Branch(names[i].c_str(), &fColumns[id].stored, (names[i] + "/D").c_str());
+            fPersisted.push_back(id);
+        }
+        return friendTree;
+    }
+
+    // Evaluate the persisted columns for the current entry and fill the friend tree
+    void FillFriendTree(TTree *friendTree) {
+        for (size_t i = 0; i < fPersisted.size(); i++) {
+            Column &c = fColumns[fPersisted[i]];
+            c.stored = Get(fPersisted[i]);
+        }
+        friendTree->Fill();
+    }
+
+    // Read the columns found in a friend tree written by MakeFriendTree instead of computing them
+    void AttachFriendTree(TTree *friendTree) {
+        for (size_t id = 0; id < fColumns.size(); id++) {
+            TBranch *branch = friendTree->GetBranch(fColumns[id].name.c_str());
+            if (!branch) continue;
+            branch->SetAddress(&fColumns[id].stored);
+            fColumns[id].branch = branch;
+        }
+        fBlockStart = -1;
+    }
+
+private:
+    struct Column {
+        std::string name;
+        Formula formula;
+        TBranch *branch = 0;  // Friend branch the column is read from, if attached
+        Double_t stored = 0;  // Branch buffer of the friend tree
+    };
+
+    double Evaluate(int id) {
+        Column &c = fColumns[id];
+        if (c.branch) {
+            c.branch->GetEntry(fEntry);
+            return c.stored;
+        }
+        return c.formula();
+    }
+
+    int fBlockSize;
+    Long64_t fBlockStart, fEntry;
+    std::vector<Column> fColumns;
+    std::map<std::string, int> fIndex;
+    std::vector<double> fValues;  // [column][entry - fBlockStart]
+    std::vector<char> fDone;
+    std::vector<int> fPersisted;
+};
+
+// The derived quantities of the run tree used across the analyses
+inline void DefineRunColumns(DerivedColumns &columns, const Short_t (&adcVal)[23][45], const Double_t (&area)[23],
+                             const Int_t (&peakPosition)[23], const Double_t (&mu1)[12]) {
+    // RMS of the peak positions of the 12 PMTs (CalculateMeanAndRMS in MichelSpectrumwithCuts)
+    columns.Define("peakPositionRMS", [&]() {
+        double mean = 0, rms = 0;
+        for (int pmt = 0; pmt < 12; pmt++) mean += peakPosition[HardwareChannel(pmt)];
+        mean /= 12;
+        for (int pmt = 0; pmt < 12; pmt++) rms += pow(peakPosition[HardwareChannel(pmt)] - mean, 2);
+        return sqrt(rms / 12);
+    });
+    columns.Alias("peakPosition_rms", "peakPositionRMS");
+
+    // Total photoelectrons of the 12 PMTs with the SPE gains mu1
+    columns.Define("totalPE", [&]() {
+        double totalPE = 0;
+        for (int pmt = 0; pmt < 12; pmt++) totalPE += area[HardwareChannel(pmt)] / mu1[pmt];
+        return totalPE;
+    });
+
+    // Largest sample of the event over all channels (y range of the waveform plotters)
+    columns.Define("maxADC", [&]() {
+        Short_t maxADC = adcVal[0][0];
+        for (int i = 0; i < 23; i++)
+            for (int k = 0; k < 45; k++) maxADC = std::max(maxADC, adcVal[i][k]);
+        return (double)maxADC;
+    });
+
+    // Largest SiPM sample (muon veto, threshold 1000 ADC)
+    columns.Define("maxSiPMADC", [&]() {
+        Short_t maxADC = adcVal[HardwareChannel(kNumPMTs)][0];
+        ForEachChannel<kSiPMChannel>([&](int p) {
+            for (int k = 0; k < 45; k++) maxADC = std::max(maxADC, adcVal[HardwareChannel(p)][k]);
+        });
+        return (double)maxADC;
+    });
+}
+
+#endif
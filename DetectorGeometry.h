@@ -0,0 +1,135 @@
+//DetectorGeometry.h is the one description of the detector channels for all tools: for every PMT and SiPM its hardware channel
+//(index into the 23-channel arrays of the tree: adcVal, area, pulseH, ...), its kind and number, and its slot in the combined
+//6x5 display layout of the physical location (waveformsBasedOnPhysicalLocation). The PMT-only 4x3 layout (onlyPMTsWaveform) is
+//the inner block, rows 1-4 and columns 1-3, of the 6x5 layout. Everything is constexpr and checked by static_assert at compile
+//time, so a wrong entry does not compile instead of silently swapping two plots.
+//Physical index: 0-11 are PMT 1-12 (the pmtChannelMap order of the plotters), 12-21 are SiPM 1-10.
+//  HardwareChannel(p), PhysicalIndex(hw)       - between physical index and hardware channel
+//  DisplaySlot(row, col), PMTDisplaySlot(...)  - physical index shown in a pad of the 6x5 or 4x3 layout, -1 for an empty pad
+//  ChannelX(p), ChannelY(p)                    - position in the layout plane in units of the PMT pitch
+//  ForEachChannel<kPMTChannel>(f)              - calls f(p) for the physical indices of a channel group
+//  PhysicalBlock<T>                            - values of a block of events transposed once into physical order, channel-major:
+//
+//    PhysicalBlock<Double_t> areaBlock;
+//    ... tree->GetEntry(entry); areaBlock.Add(area); if (areaBlock.Full()) { fill from areaBlock.Channel(p); areaBlock.Clear(); }
+//
+//so loops over the PMTs read contiguous memory instead of gathering area[pmtChannelMap[pmt]] event by event.
+#ifndef DETECTORGEOMETRY_H
+#define DETECTORGEOMETRY_H
+
+#include <Rtypes.h>
+#include <vector>
+
+enum ChannelKind { kPMTChannel, kSiPMChannel };
+
+struct ChannelInfo {
+    int hardware;     // Channel in the arrays of the tree
+    ChannelKind kind;
+    int number;       // PMT 1-12 or SiPM 1-10, as on the plots
+    int row, col;     // Pad in the combined 6x5 layout
+};
+
+constexpr int kNumTreeChannels = 23; // Channels in the tree; channel 22 is not connected
+constexpr int kNumPMTs = 12;
+constexpr int kNumSiPMs = 10;
+constexpr int kNumDetectorChannels = kNumPMTs + kNumSiPMs;
+constexpr int kDisplayRows = 6, kDisplayCols = 5;
+constexpr int kPMTDisplayRows = 4, kPMTDisplayCols = 3;
+
+// Indexed by physical index
+constexpr ChannelInfo kDetector[kNumDetectorChannels] = {
+    { 0, kPMTChannel,   1, 3, 1}, {10, kPMTChannel,   2, 3, 3}, { 7, kPMTChannel,   3, 4, 3}, { 2, kPMTChannel,   4, 1, 2},
+    { 6, kPMTChannel,   5, 2, 2}, { 3, kPMTChannel,   6, 2, 1}, { 8, kPMTChannel,   7, 3, 2}, { 9, kPMTChannel,   8, 1, 3},
+    {11, kPMTChannel,   9, 2, 3}, { 4, kPMTChannel,  10, 1, 1}, { 5, kPMTChannel,  11, 4, 1}, { 1, kPMTChannel,  12, 4, 2},
+    {12, kSiPMChannel,  1, 1, 4}, {13, kSiPMChannel,  2, 4, 4}, {14, kSiPMChannel,  3, 5, 1}, {15, kSiPMChannel,  4, 2, 0},
+    {16, kSiPMChannel,  5, 1, 0}, {17, kSiPMChannel,  6, 3, 4}, {18, kSiPMChannel,  7, 5, 2}, {19, kSiPMChannel,  8, 3, 0},
+    {20, kSiPMChannel,  9, 0, 2}, {21, kSiPMChannel, 10, 0, 3}
+};
+
+constexpr int HardwareChannel(int p) { return kDetector[p].hardware; }
+
+// Physical index of a hardware channel, -1 for a channel without detector
+constexpr int PhysicalIndex(int hardware) {
+    for (int p = 0; p < kNumDetectorChannels; p++) {
+        if (kDetector[p].hardware == hardware) return p;
+    }
+    return -1;
+}
+
+// Physical index shown in a pad of the combined 6x5 layout, -1 for an empty pad
+constexpr int DisplaySlot(int row, int col) {
+    for (int p = 0; p < kNumDetectorChannels; p++) {
+        if (kDetector[p].row == row && kDetector[p].col == col) return p;
+    }
+    return -1;
+}
+
+// Physical index (a PMT) shown in a pad of the PMT 4x3 layout
+constexpr int PMTDisplaySlot(int row, int col) { return DisplaySlot(row + 1, col + 1); }
+
+// Position of a channel in the plane of the layout, in units of the pad (PMT) pitch: origin at the center of the PMT block,
+// x to the right, y up (row 0 is the top row)
+constexpr double ChannelX(int p) { return kDetector[p].col - 2.0; }
+constexpr double ChannelY(int p) { return 2.5 - kDetector[p].row; }
+
+// Channel groups as ranges of physical indices
+template <ChannelKind Kind> struct ChannelGroup;
+template <> struct ChannelGroup<kPMTChannel> { static constexpr int begin = 0, end = kNumPMTs; };
+template <> struct ChannelGroup<kSiPMChannel> { static constexpr int begin = kNumPMTs, end = kNumDetectorChannels; };
+
+template <ChannelKind Kind, class F>
+inline void ForEachChannel(F f) {
+    for (int p = ChannelGroup<Kind>::begin; p < ChannelGroup<Kind>::end; p++) f(p);
+}
+
+// Compile-time checks of the table
+constexpr bool GeometryIsConsistent() {
+    int numbers[2] = {0, 0};
+    for (int p = 0; p < kNumDetectorChannels; p++) {
+        const ChannelInfo &c = kDetector[p];
+        ChannelKind groupKind = (p < kNumPMTs) ? kPMTChannel : kSiPMChannel;
+        if (c.kind != groupKind || c.number != ++numbers[c.kind]) return false;
+        if (c.hardware < 0 || c.hardware >= kNumTreeChannels || PhysicalIndex(c.hardware) != p) return false;
+        if (c.row < 0 || c.row >= kDisplayRows || c.col < 0 || c.col >= kDisplayCols || DisplaySlot(c.row, c.col) != p) return false;
+    }
+    return true;
+}
+
+constexpr bool PMTBlockIsFull() {
+    for (int row = 0; row < kPMTDisplayRows; row++) {
+        for (int col = 0; col < kPMTDisplayCols; col++) {
+            int p = PMTDisplaySlot(row, col);
+            if (p < 0 || kDetector[p].kind != kPMTChannel) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(GeometryIsConsistent(), "DetectorGeometry: duplicate channel or pad, or channels out of physical order");
+static_assert(PMTBlockIsFull(), "DetectorGeometry: the PMT 4x3 layout must be the PMTs of rows 1-4, columns 1-3");
+static_assert(HardwareChannel(0) == 0 && HardwareChannel(1) == 10 && HardwareChannel(11) == 1,
+              "DetectorGeometry: PMT order differs from pmtChannelMap");
+
+// Values of up to BlockSize events in physical order, channel-major: Channel(p)[i] is channel p of the i-th added event
+template <class T, int BlockSize = 1024>
+class PhysicalBlock {
+public:
+    PhysicalBlock() : fValues(kNumDetectorChannels * BlockSize), fSize(0) {}
+
+    // Add one event from its hardware-ordered array (e.g. area[23])
+    void Add(const T *hardwareValues) {
+        for (int p = 0; p < kNumDetectorChannels; p++) fValues[p * BlockSize + fSize] = hardwareValues[kDetector[p].hardware];
+        fSize++;
+    }
+
+    const T *Channel(int p) const { return &fValues[p * BlockSize]; }
+    int Size() const { return fSize; }
+    bool Full() const { return fSize == BlockSize; }
+    void Clear() { fSize = 0; }
+
+private:
+    std::vector<T> fValues;
+    int fSize;
+};
+
+#endif
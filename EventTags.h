@@ -0,0 +1,19 @@
+//Bits of the per-entry tag word written by classifyEvents to the friend tree "tagTree".
+//Downstream tools can read only the tags, or use the TEntryList of a tag stored next to the tree to skip to the entries they need.
+#ifndef EVENTTAGS_H
+#define EVENTTAGS_H
+
+enum EventTag {
+    kTagMuon           = 1 << 0, // A SiPM of the veto is above the muon threshold
+    kTagLED            = 1 << 1, // Low light LED event (triggerBits == 16)
+    kTagPMTTrigger     = 1 << 2, // PMT trigger (triggerBits == 2)
+    kTagMichel         = 1 << 3, // PMT trigger passing the Michel afterpulse cuts of MichelSpectrumwithCuts
+    kTagAfterpulseLike = 1 << 4, // PMT trigger failing those cuts
+    kTagHighRMS        = 1 << 5  // At least one channel with baselineRMS above the noise threshold
+};
+
+const int nEventTags = 6;
+const double kHighRMSThreshold = 2.0; // baselineRMS of a noisy channel (kTagHighRMS, HighRMS.cpp)
+const char *const eventTagNames[nEventTags] = {"muon", "led", "pmtTrigger", "michel", "afterpulseLike", "highRMS"};
+
+#endif
@@ -0,0 +1,115 @@
+//FastHist is a minimal fixed-binning histogram for filling in hot event loops, converted to a TH1F only for fitting and drawing.
+//Bins are plain integer counters and the bin index is computed without branches (underflow -> bin 0, overflow -> bin nBins+1,
+//as in TH1). Counters are split into shards: each thread fills its own shard with Fill(x, shard) without any locking,
+//or any thread can use AtomicFill(x) on the shared atomic counters. Every shard starts on a 64-byte cache line and is padded to
+//whole lines, so threads filling different shards never write to the same line. ToTH1F() adds up all shards.
+//
+//    FastHist h("timeDiffHist", "Time Difference; Time Difference [ns]; Counts", 100, 0, 10000, nThreads);
+//    h.Fill(dt, threadIndex);          // per-thread shard, no synchronization
+//    TH1F *hist = h.ToTH1F();          // caller owns the TH1F (not attached to any directory)
+#ifndef FASTHIST_H
+#define FASTHIST_H
+
+#include <TH1F.h>
+#include <TString.h>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+
+class FastHist {
+public:
+    FastHist(const char *name, const char *title, int nBins, double xMin, double xMax, int nShards = 1)
+        : fName(name), fTitle(title), fNBins(nBins), fXMin(xMin), fXMax(xMax),
+          fScale(nBins / (xMax - xMin)), fNShards(nShards < 1 ? 1 : nShards),
+          fStride(((nBins + 2) + kLineCounts - 1) / kLineCounts * kLineCounts),
+          fStorage(fStride * fNShards + kLineCounts - 1, 0),
+          fAtomicCounts(new std::atomic<ULong64_t>[nBins + 2]) {
+        for (int i = 0; i < fNBins + 2; i++) fAtomicCounts[i].store(0, std::memory_order_relaxed);
+        // First counter of the storage on a cache line boundary
+        size_t misalignment = reinterpret_cast<uintptr_t>(fStorage.data()) % kLineBytes;
+        fCounts = fStorage.data() + (misalignment ? (kLineBytes - misalignment) / sizeof(ULong64_t) : 0);
+    }
+
+    // Bin of x in TH1 numbering: 0 underflow, 1..nBins, nBins+1 overflow. NaN goes to underflow.
+    inline int FindBin(double x) const {
+        double t = (x - fXMin) * fScale + 1.0;
+        t = std::fmax(t, 0.0);
+        t = std::fmin(t, fNBins + 1.0);
+        return (int)t;
+    }
+
+    // Fill the shard of the calling thread; a shard must only be filled by one thread at a time
+    inline void Fill(double x, int shard = 0) {
+        fCounts[shard * fStride + FindBin(x)]++;
+    }
+
+    // Fill n contiguous values (e.g. one channel of a PhysicalBlock, DetectorGeometry.h)
+    inline void FillN(const double *x, int n, int shard = 0) {
+        ULong64_t *counts = &fCounts[shard * fStride];
+        for (int i = 0; i < n; i++) counts[FindBin(x[i])]++;
+    }
+
+    // Fill from any thread
+    inline void AtomicFill(double x) {
+        fAtomicCounts[FindBin(x)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Content of a bin summed over all shards (TH1 bin numbering)
+    ULong64_t GetBinContent(int bin) const {
+        ULong64_t sum = fAtomicCounts[bin].load(std::memory_order_relaxed);
+        for (int s = 0; s < fNShards; s++) sum += fCounts[s * fStride + bin];
+        return sum;
+    }
+
+    ULong64_t GetEntries() const {
+        ULong64_t sum = 0;
+        for (int bin = 0; bin < fNBins + 2; bin++) sum += GetBinContent(bin);
+        return sum;
+    }
+
+    // Add the counts of another FastHist with the same binning (e.g. from another file)
+    void Add(const FastHist &other) {
+        for (int bin = 0; bin < fNBins + 2; bin++) fCounts[bin] += other.GetBinContent(bin);
+    }
+
+    void Reset() {
+        std::fill(fCounts, fCounts + (size_t)fStride * fNShards, 0);
+        for (int i = 0; i < fNBins + 2; i++) fAtomicCounts[i].store(0, std::memory_order_relaxed);
+    }
+
+    // Build a TH1F with the summed contents. Statistics (mean, RMS) are computed from the bin centers.
+    TH1F *ToTH1F(const char *name = 0) const {
+        TH1F *hist = new TH1F(name ? name : fName.Data(), fTitle, fNBins, fXMin, fXMax);
+        hist->SetDirectory(0);
+        ULong64_t entries = 0;
+        for (int bin = 0; bin < fNBins + 2; bin++) {
+            ULong64_t content = GetBinContent(bin);
+            hist->SetBinContent(bin, content);
+            entries += content;
+        }
+        hist->ResetStats();
+        hist->SetEntries(entries);
+        return hist;
+    }
+
+    int GetNbins() const { return fNBins; }
+    int GetNShards() const { return fNShards; }
+
+private:
+    static const int kLineBytes = 64;
+    static const int kLineCounts = kLineBytes / sizeof(ULong64_t);
+
+    TString fName, fTitle;
+    int fNBins;
+    double fXMin, fXMax, fScale;
+    int fNShards;
+    int fStride;
+    std::vector<ULong64_t> fStorage;   // Shards plus the slack to align them
+    ULong64_t *fCounts;                // Shard 0, on a cache line boundary inside fStorage
+    std::unique_ptr<std::atomic<ULong64_t>[]> fAtomicCounts;
+};
+
+#endif
@@ -1,13 +1,21 @@
+//This code collects the waveforms of the channels whose baselineRMS is above the noise threshold and plots them per channel.
+//With the tags of classifyEvents (tags_output.root) only the entries of its highRMSEntries list are read, and the noisy channels
+//are taken from the highRMSChannels mask of tagTree instead of being recomputed. With --entries begin:end only those entries are read.
 #include <TFile.h>
 #include <TTree.h>
+#include <TEntryList.h>
 #include <TCanvas.h>
 #include <TH1.h>
 #include <TString.h>
 #include <iostream>
 #include <vector>
 #include <TAxis.h>  // Include TAxis header for proper definition
+#include "EventTags.h"
+#include "RunFileIO.h"
+#include <string>
 
-void ExtractAndPlotHighRMS(const char* filename, double highRMSThreshold = 2.0) {
+void ExtractAndPlotHighRMS(const char* filename, const char* tagsName = 0, EntryRange range = EntryRange(),
+                           double highRMSThreshold = kHighRMSThreshold) {
     // Open the ROOT file
     TFile *file = TFile::Open(filename);
     if (!file || file->IsZombie()) {
@@ -23,10 +31,6 @@ void ExtractAndPlotHighRMS(const char* filename, double highRMSThreshold = 2.0)
         return;
     }
 
-    // Define channel mappings
-    int pmtChannelMap[12] = {0, 10, 7, 2, 6, 3, 8, 9, 11, 4, 5, 1};
-    int sipmChannelMap[10] = {12, 13, 14, 15, 16, 17, 18, 19, 20, 21};
-
     // Define branches (correct data types)
     Double_t baselineRMS[23];  // Assuming 23 channels (for PMTs, SiPMs, and Event61)
     Short_t adcVal[23][45];    // Assuming 23 channels with 45 samples each
@@ -51,18 +55,48 @@ void ExtractAndPlotHighRMS(const char* filename, double highRMSThreshold = 2.0)
         return;
     }
 
-    // Loop over all events and apply the RMS threshold
+    // Entries to read: all of them, or the ones tagged highRMS by classifyEvents
+    Long64_t nEntries = tree->GetEntries();
+    TFile *tagsFile = 0;
+    TTree *tagTree = 0;
+    TEntryList *highRMSEntries = 0;
+    UInt_t highRMSChannels = 0;
+    if (tagsName) {
+        tagsFile = TFile::Open(tagsName);
+        if (!tagsFile || tagsFile->IsZombie()) {
+            std::cerr << "Error: Cannot open the tags file " << tagsName << std::endl;
+            delete tagsFile;
+            file->Close();
+            return;
+        }
+        tagTree = (TTree*)tagsFile->Get("tagTree");
+        highRMSEntries = (TEntryList*)tagsFile->Get("highRMSEntries");
+        if (!tagTree || !highRMSEntries || tagTree->GetEntries() != nEntries) {
+            std::cerr << "Error: " << tagsName << " does not hold the tags of every entry of " << filename << std::endl;
+            tagsFile->Close();
+            delete tagsFile;
+            file->Close();
+            return;
+        }
+        tagTree->SetBranchAddress("highRMSChannels", &highRMSChannels);
+    }
+    ClampEntryRange(range, nEntries);
+    Long64_t nSelected = highRMSEntries ? highRMSEntries->GetN() : range.end - range.begin;
+
+    // Loop over the events and apply the RMS threshold
     std::vector<int> selectedEventIDs;
     std::vector<std::vector<Short_t>> selectedADCValues[23]; // Store selected ADC values for each channel
 
-    int nEntries = tree->GetEntries();
-    for (int entry = 0; entry < nEntries; ++entry) {
+    for (Long64_t n = 0; n < nSelected; ++n) {
+        Long64_t entry = highRMSEntries ? highRMSEntries->GetEntry(n) : range.begin + n;
+        if (entry < range.begin || entry >= range.end) continue;
         tree->GetEntry(entry);
+        if (tagTree) tagTree->GetEntry(entry);
 
         // Loop through all channels
         for (int i = 0; i < 23; ++i) {
-            double rms = baselineRMS[i];
-            if (rms > highRMSThreshold) {
+            bool highRMS = tagTree ? (highRMSChannels & (1u << i)) != 0 : baselineRMS[i] > highRMSThreshold;
+            if (highRMS) {
                 // Event passes the RMS cut, so save this event's data
                 selectedEventIDs.push_back(eventID);  // Save the event ID
                 std::vector<Short_t> adcValuesForEvent;
@@ -76,6 +110,11 @@ void ExtractAndPlotHighRMS(const char* filename, double highRMSThreshold = 2.0)
         }
     }
 
+    if (tagsFile) {
+        tagsFile->Close();
+        delete tagsFile;
+    }
+
     // Check if we have any selected events
     if (selectedEventIDs.empty()) {
         std::cerr << "No events passed the RMS threshold!" << std::endl;
@@ -120,12 +159,25 @@ void ExtractAndPlotHighRMS(const char* filename, double highRMSThreshold = 2.0)
 
 // Main function to accept filename from terminal and call ExtractAndPlotHighRMS
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <root_file>" << std::endl;
+    EntryRange range;
+    std::vector<const char*> args;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], range)) {
+                std::cerr << "Error: invalid entry range " << argv[i] << std::endl;
+                return 1;
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() < 1 || args.size() > 2) {
+        std::cerr << "Usage: " << argv[0] << " <root_file> [tags_output.root] [--entries begin:end]" << std::endl;
         return 1;
     }
 
-    const char* filename = argv[1]; // Get the filename from the command line
-    ExtractAndPlotHighRMS(filename); // Call the function to extract and plot high RMS events
+    const char* filename = args[0]; // Get the filename from the command line
+    const char* tagsName = (args.size() == 2) ? args[1] : 0; // Tags of classifyEvents (optional)
+    ExtractAndPlotHighRMS(filename, tagsName, range); // Call the function to extract and plot high RMS events
     return 0;
 }
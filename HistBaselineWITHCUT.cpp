@@ -1,13 +1,26 @@
+//This code fills the baselineRMS histogram of every PMT and SiPM channel, and a second histogram with only the values above the channel's mean.
+//The histograms and the combined-canvas layout (physical location of the PMTs/SiPMs) are written to a results file;
+//renderResults draws the individual and combined canvases from it.
+//--preview FRACTION reads only a spread-out subset of the clusters (the read-ahead cache is limited to each sampled cluster, so the
+//skipped ones are not read): the histograms are scaled up to the whole run and the mean baseline RMS of every channel is printed
+//with its uncertainty. The events of a cluster are not independent (same period of the run), so the uncertainty comes from the
+//spread of the cluster sums (ratio estimator over the sampled clusters), not from the spread of the events.
 #include <TFile.h>
 #include <TTree.h>
-#include <TCanvas.h>
-#include <TH1.h>
+#include <TH1F.h>
 #include <TString.h>
+#include <TParameter.h>
+#include <TVectorD.h>
+#include "RunFileIO.h"
+#include "DetectorGeometry.h"
 #include <iostream>
-#include "TStyle.h"
-#include <TLatex.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 
-void HistBaselineRMS(const char* filename) {
+void HistBaselineRMS(const char* filename, const char* resultsName, double previewFraction) {
     // Open the ROOT file
     TFile *file = TFile::Open(filename);
     if (!file || file->IsZombie()) {
@@ -23,124 +36,157 @@ void HistBaselineRMS(const char* filename) {
         return;
     }
 
-    // Define channel mappings
-    int pmtChannelMap[12] = {0, 10, 7, 2, 6, 3, 8, 9, 11, 4, 5, 1};
-    int sipmChannelMap[10] = {12, 13, 14, 15, 16, 17, 18, 19, 20, 21};
-
-    // Create a master canvas with sufficient pads (6 rows, 5 columns)
-    TCanvas *masterCanvas = new TCanvas("MasterCanvas", "Combined PMT and SiPM Histogram", 3600, 3000); 
-    masterCanvas->Divide(5, 6); // 5 columns and 6 rows to accommodate 23 plots
+    // One histogram of all values and one after the cut per channel (physical index): 100 bins in [0, 10]
+    TH1F *hist[kNumDetectorChannels], *histAfterCut[kNumDetectorChannels];
+    for (int ch = 0; ch < kNumDetectorChannels; ++ch) {
+        TString title = TString::Format("%s %d ", (kDetector[ch].kind == kPMTChannel) ? "PMT" : "SiPM", kDetector[ch].number);
+        hist[ch] = new TH1F(TString::Format("hist_baselineRMS_ch%d", ch), title + ";Baseline RMS;Counts", 100, 0, 10);
+        histAfterCut[ch] = new TH1F(TString::Format("hist_baselineRMS_cut_ch%d", ch), title + ";Baseline RMS;Counts", 100, 0, 10);
+    }
 
-    // Define the custom layout for the combined chart based on channel mapping
-    int layout[6][5] = {
-        {-1,  -1,  20,  21, -1},   // Row 1 (SiPM20, SiPM21)
-        {16,  9,   3,   7,  12},   // Row 2 (SiPM16, PMT9, PMT3, PMT7, SiPM12)
-        {15,  5,   4,   8,   -1},  // Row 3 (SiPM15, PMT5, PMT4, PMT8)
-        {19,  0,   6,   1,  17},   // Row 4 (SiPM19, PMT0, PMT6, PMT1, SiPM17)
-        {-1,  10,  11,  2,  13},   // Row 5 (PMT10, PMT11, PMT2, SiPM13)
-        {-1,  14,  18,  -1, -1}    // Row 6 (SiPM14, SiPM18)
+    Double_t baselineRMS[23];
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("baselineRMS", 1);
+    tree->SetBranchAddress("baselineRMS", baselineRMS);
+    CacheActiveBranches(tree);
+    Long64_t nEntries = tree->GetEntries();
+
+    // Whole run, or a spread-out subset of its clusters in preview mode
+    std::vector<EntryRange> ranges = PreviewRanges(tree, previewFraction);
+
+    // Events are collected in blocks in physical order; each channel is then processed from one contiguous array
+    PhysicalBlock<Double_t> block;
+    double sum[kNumDetectorChannels] = {0};
+    Long64_t nRead = 0;
+    auto firstPass = [&]() {
+        for (int ch = 0; ch < kNumDetectorChannels; ++ch) {
+            const Double_t *values = block.Channel(ch);
+            for (int i = 0; i < block.Size(); ++i) {
+                hist[ch]->Fill(values[i]);
+                sum[ch] += values[i];
+            }
+        }
+        block.Clear();
     };
-    
-    / Create a large font textbox on the master canvas
-    masterCanvas->cd(0); // Select the canvas itself (outside the pads)
-    TLatex *textbox = new TLatex(); // Create a TLatex object for drawing text
-    textbox->SetTextSize(0.02); // Set text size
-    textbox->SetTextAlign(13);  // Align bottom-left
-    textbox->SetNDC(true);      // Use normalized device coordinates
-    textbox->DrawLatex(0.01, 0.10, "X axis: BaselineRMS"); // Draw the first line of text
-    textbox->DrawLatex(0.01, 0.08, "Y axis: Counts"); // Draw the second line of text
-    // Loop through the layout and plot histograms for each channel
-    for (int row = 0; row < 6; ++row) {
-        for (int col = 0; col < 5; ++col) {
-            int ch = layout[row][col];
-            if (ch == -1) continue; // Skip empty spots in the layout
-
-            int isPMT = (ch < 12); // Check if it's a PMT channel (0-11 for PMTs)
-            int isSiPM = (ch >= 12 && ch < 22); // Check if it's a SiPM channel (12-21 for SiPMs)
-
-            masterCanvas->cd(row * 5 + col + 1); // Switch to the correct pad based on the layout
-
-            // Define a unique histogram name for each channel
-            TString histName = TString::Format("hist_baselineRMS_ch%d", ch);
-
-            // Construct the draw command: baselineRMS[ch] is plotted with 100 bins in the range [0, 10]
-            TString drawCmd;
-            if (isPMT && ch < 12) {
-                drawCmd = TString::Format("baselineRMS[%d] >> %s(100, 0, 10)", pmtChannelMap[ch], histName.Data());
-            } else if (isSiPM && ch - 12 < 10) {
-                drawCmd = TString::Format("baselineRMS[%d] >> %s(100, 0, 10)", sipmChannelMap[ch - 12], histName.Data());
+    double cutMean[kNumDetectorChannels];
+    auto secondPass = [&]() {
+        for (int ch = 0; ch < kNumDetectorChannels; ++ch) {
+            const Double_t *values = block.Channel(ch);
+            for (int i = 0; i < block.Size(); ++i) {
+                if (values[i] > cutMean[ch]) histAfterCut[ch]->Fill(values[i]);
             }
+        }
+        block.Clear();
+    };
 
-            // Draw the first histogram for the current channel (all data)
-            tree->Draw(drawCmd, "", "hist");
-
-            // Retrieve the histogram from the pad
-            TH1 *hist = (TH1*)gPad->GetPrimitive(histName);
-            if (hist) {
-                // Calculate the mean of the histogram
-                double mean = hist->GetMean();
-
-                // Create a new histogram for data after applying the cut (values above the mean)
-                TString histAfterCutName = TString::Format("hist_baselineRMS_cut_ch%d", ch);
-                TString drawCmdAfterCut;
-                if (isPMT && ch < 12) {
-                    drawCmdAfterCut = TString::Format("baselineRMS[%d] >> %s(100, 0, 10)", pmtChannelMap[ch], histAfterCutName.Data());
-                } else if (isSiPM && ch - 12 < 10) {
-                    drawCmdAfterCut = TString::Format("baselineRMS[%d] >> %s(100, 0, 10)", sipmChannelMap[ch - 12], histAfterCutName.Data());
-                }
+    // First pass: all values, whose histogram gives the mean used by the cut. The sums of every cluster are kept for the uncertainty.
+    std::vector<double> rangeSum(ranges.size() * kNumDetectorChannels);
+    for (size_t r = 0; r < ranges.size(); ++r) {
+        double sumBefore[kNumDetectorChannels];
+        std::copy(sum, sum + kNumDetectorChannels, sumBefore);
+        tree->SetCacheEntryRange(ranges[r].begin, ranges[r].end); // Prefetch only this cluster
+        for (Long64_t entry = ranges[r].begin; entry < ranges[r].end; ++entry) {
+            tree->GetEntry(entry);
+            block.Add(baselineRMS);
+            if (block.Full()) firstPass();
+        }
+        firstPass();
+        for (int ch = 0; ch < kNumDetectorChannels; ++ch) rangeSum[r * kNumDetectorChannels + ch] = sum[ch] - sumBefore[ch];
+        nRead += ranges[r].end - ranges[r].begin;
+    }
 
-                // Draw the second histogram with the cut (only values greater than mean)
-                tree->Draw(drawCmdAfterCut, TString::Format("baselineRMS[%d] > %f", (isPMT ? pmtChannelMap[ch] : sipmChannelMap[ch - 12]), mean), "hist same");
+    // Second pass: only values greater than the mean of the channel's histogram, which (as TH1::GetMean) leaves out the values
+    // outside [0, 10]
+    for (int ch = 0; ch < kNumDetectorChannels; ++ch) cutMean[ch] = hist[ch]->GetMean();
+    if (nRead > 0) {
+        for (size_t r = 0; r < ranges.size(); ++r) {
+            tree->SetCacheEntryRange(ranges[r].begin, ranges[r].end);
+            for (Long64_t entry = ranges[r].begin; entry < ranges[r].end; ++entry) {
+                tree->GetEntry(entry);
+                block.Add(baselineRMS);
+                if (block.Full()) secondPass();
+            }
+        }
+        secondPass();
+    }
 
-                // Retrieve the new histogram
-                TH1 *histAfterCut = (TH1*)gPad->GetPrimitive(histAfterCutName);
-                if (histAfterCut) {
-                    histAfterCut->SetLineColor(kRed); // Set the color for the histogram after cut (Red)
-                }
-                     // Set large font size for title
-                    gStyle->SetTitleFontSize(0.11);  // You can adjust this size to fit your needs
-                // Set titles and labels for the histograms
-                if (isPMT && ch < 12) {
-                    int pmtIndex = -1;
-                    for (int i = 0; i < 12; ++i) {
-                        if (pmtChannelMap[i] == ch) {
-                            pmtIndex = i + 1; // PMT number starts from 1
-                            break;
-                        }
-                    }
-                    hist->SetTitle(TString::Format("PMT %d ", pmtIndex));
-                } else if (isSiPM && ch - 12 < 10) {
-                    hist->SetTitle(TString::Format("SiPM %d ", sipmChannelMap[ch - 12] - 11)); // SiPM number starts from 1
+    // Preview: mean baseline RMS with its uncertainty between clusters, histograms scaled to the whole run
+    double sampledFraction = (nEntries > 0) ? (double)nRead / nEntries : 1;
+    if (previewFraction < 1 && nRead > 1) {
+        std::cout << "Preview: read " << nRead << " of " << nEntries << " entries (" << 100 * sampledFraction << "%) in "
+                  << ranges.size() << " clusters" << std::endl;
+        size_t nClusters = ranges.size();
+        for (int ch = 0; ch < kNumDetectorChannels; ++ch) {
+            double mean = sum[ch] / nRead;
+            std::cout << hist[ch]->GetTitle() << ": mean baseline RMS = " << mean;
+            if (nClusters > 1) {
+                // Ratio estimator of the mean over a sample of clusters: residual of every cluster sum against mean x its size
+                double residual2 = 0;
+                for (size_t r = 0; r < nClusters; ++r) {
+                    double residual = rangeSum[r * kNumDetectorChannels + ch] - mean * (ranges[r].end - ranges[r].begin);
+                    residual2 += residual * residual;
                 }
-                hist->GetXaxis()->SetTitle("Baseline RMS"); // Label the X-axis
-                hist->GetYaxis()->SetTitle("Counts");       // Label the Y-axis
-
-                // Save the individual histogram as a PNG image
-                TCanvas *individualCanvas = new TCanvas(TString::Format("Canvas_ch%d", ch), TString::Format("Channel %d Histogram", ch), 800, 600);
-                hist->Draw();
-                histAfterCut->Draw("same"); // Overlay the second histogram
-                individualCanvas->SaveAs(TString::Format("channel_%d_histogram.png", ch));
-                delete individualCanvas; // Clean up the individual canvas
+                std::cout << " +/- " << sqrt(nClusters / (nClusters - 1.0) * residual2) / nRead << std::endl;
+            } else {
+                std::cout << " (one cluster read, no uncertainty)" << std::endl;
             }
+            hist[ch]->Scale(1.0 / sampledFraction);
+            histAfterCut[ch]->Scale(1.0 / sampledFraction);
         }
     }
 
-    // Save the entire canvas as a PNG image for later review
-    masterCanvas->SaveAs("combined_baselineRMS_histograms.png");
+    // Save the histograms and the layout for renderResults
+    TVectorD layoutVec(kDisplayRows * kDisplayCols);
+    for (int row = 0; row < kDisplayRows; ++row) {
+        for (int col = 0; col < kDisplayCols; ++col) {
+            layoutVec[row * kDisplayCols + col] = DisplaySlot(row, col);
+        }
+    }
 
-    // Clean up: Close the file (optional but good practice)
+    TFile *results = new TFile(resultsName, "RECREATE");
+    if (!results || results->IsZombie()) {
+        std::cerr << "Error: Cannot create the results file!" << std::endl;
+        file->Close();
+        return;
+    }
+    for (int ch = 0; ch < kNumDetectorChannels; ++ch) {
+        hist[ch]->Write();
+        histAfterCut[ch]->Write();
+    }
+    TParameter<Double_t>("sampledFraction", sampledFraction).Write();
+    TNamed("resultKind", "baselineRMS").Write();
+    TParameter<Int_t>("layoutRows", kDisplayRows).Write();
+    TParameter<Int_t>("layoutCols", kDisplayCols).Write();
+    layoutVec.Write("layout");
+    results->Close();
+    delete results;
+
+    // Clean up
+    for (int ch = 0; ch < kNumDetectorChannels; ++ch) {
+        delete hist[ch];
+        delete histAfterCut[ch];
+    }
     file->Close();
+
+    std::cout << "Histograms saved in " << resultsName << ". Draw them with: renderResults " << resultsName << std::endl;
 }
 
 // Main function to accept filename from terminal and call HistBaselineRMS
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <root_file>" << std::endl;
+    double previewFraction = 1;
+    std::vector<const char*> args;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--preview" && i + 1 < argc) previewFraction = atof(argv[++i]);
+        else args.push_back(argv[i]);
+    }
+    if (args.size() < 1 || args.size() > 2 || previewFraction <= 0) {
+        std::cerr << "Usage: " << argv[0] << " <root_file> [results.root] [--preview FRACTION]" << std::endl;
         return 1;
     }
 
-    const char* filename = argv[1]; // Get the filename from the command line
-    HistBaselineRMS(filename); // Call the function to plot histograms
+    const char* filename = args[0]; // Get the filename from the command line
+    const char* resultsName = (args.size() == 2) ? args[1] : "baselineRMS_results.root";
+    InitRunFileIO();
+    HistBaselineRMS(filename, resultsName, previewFraction); // Fill the histograms and write the results
     return 0;
 }
-
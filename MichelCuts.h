@@ -0,0 +1,57 @@
+//MichelCuts.h is the afterpulse selection of the Michel electron candidates among the PMT-trigger events (triggerBits == 2), the one
+//definition used by MichelSpectrumwithCuts, classifyEvents (kTagMichel / kTagAfterpulseLike) and incrementalDatasetStore:
+//    good = (allAbove2PE || conditionB) && peakPositionRMS < 2.5
+//  allAbove2PE: every PMT has pulseH > 2 x mu1,
+//  conditionB:  (only tested when allAbove2PE fails) every PMT has pulseH > 3 x baselineRMS and area / pulseH > 1.0,
+//  peakPositionRMS: RMS of the peak positions of the 12 PMTs.
+//michelCutScan scans these thresholds.
+#ifndef MICHELCUTS_H
+#define MICHELCUTS_H
+
+#include "DetectorGeometry.h"
+#include <cmath>
+
+struct MichelCutResult {
+    bool allAbove2PE;
+    bool conditionB;
+    bool good;
+};
+
+// RMS of the peak positions of the 12 PMTs (arrays indexed by hardware channel)
+inline double PeakPositionRMS(const Int_t *peakPosition) {
+    double mean = 0, rms = 0;
+    for (int pmt = 0; pmt < kNumPMTs; pmt++) mean += peakPosition[HardwareChannel(pmt)];
+    mean /= kNumPMTs;
+    for (int pmt = 0; pmt < kNumPMTs; pmt++) rms += pow(peakPosition[HardwareChannel(pmt)] - mean, 2);
+    return sqrt(rms / kNumPMTs);
+}
+
+// pulseH, area, baselineRMS indexed by hardware channel, mu1 by PMT (physical index)
+inline MichelCutResult ApplyMichelCuts(const Double_t *pulseH, const Double_t *area, const Double_t *baselineRMS,
+                                       const Double_t *mu1, double peakPositionRMS) {
+    MichelCutResult result;
+    result.allAbove2PE = true;
+    for (int pmt = 0; pmt < kNumPMTs; pmt++) {
+        if (pulseH[HardwareChannel(pmt)] <= 2 * mu1[pmt]) {
+            result.allAbove2PE = false;
+            break;
+        }
+    }
+
+    result.conditionB = false;
+    if (!result.allAbove2PE) {
+        result.conditionB = true;
+        for (int pmt = 0; pmt < kNumPMTs; pmt++) {
+            int ch = HardwareChannel(pmt);
+            if (pulseH[ch] <= 3 * baselineRMS[ch] || (area[ch] / pulseH[ch]) <= 1.0) {
+                result.conditionB = false;
+                break;
+            }
+        }
+    }
+
+    result.good = (result.allAbove2PE || result.conditionB) && (peakPositionRMS < 2.5);
+    return result;
+}
+
+#endif
@@ -0,0 +1,74 @@
+//MuonMichelPairing pairs muons with Michel electrons exactly as analyzeMuonDecay (timeDistributionMuonMichel.cpp) does, but in a
+//single time-ordered pass instead of a look-ahead loop over the following events of every muon:
+//  - every event is a muon candidate at nsTime + the latest of the peak times of its 22 channels (analyzeMuonDecay declares a
+//    SiPM threshold but does not apply it),
+//  - its Michel electron is the first later event in which a PMT, taken in physical order, peaks within 0 - window ns after the
+//    muon; the time difference is nsTime + the peak time of that PMT - the muon time,
+//  - the search of a muon ends at the first event with nsTime more than window ns after the muon.
+//Peak times are (first largest sample + 1) x 16 ns, as findPeakTime of analyzeMuonDecay. The time differences are the same as
+//those of analyzeMuonDecay; they are only found in the order of the Michel events instead of the muons.
+//
+//    MuonMichelPairing pairing;
+//    for every entry in time order: pairing.AddEvent(nsTime, adcVal, dts);   // appends the time differences closed by the event
+#ifndef MUONMICHELPAIRING_H
+#define MUONMICHELPAIRING_H
+
+#include "DetectorGeometry.h"
+#include <vector>
+#include <algorithm>
+
+class MuonMichelPairing {
+public:
+    explicit MuonMichelPairing(double windowNs = 10000) : fWindow(windowNs) {}
+
+    // Pair the pending muons with this event, then add it as a muon candidate unless muonCandidate is false (an entry after the
+    // end of a shard's range only closes the muons of the shard). The time differences found are appended to dts.
+    void AddEvent(Long64_t nsTime, const Short_t (&adcVal)[23][45], std::vector<double> &dts, bool muonCandidate = true) {
+        double pmtPeakTime[kNumPMTs], muonPeakTime = -1;
+        for (int p = 0; p < kNumDetectorChannels; p++) {
+            double peakTime = PeakTime(adcVal[HardwareChannel(p)]);
+            if (p < kNumPMTs) pmtPeakTime[p] = peakTime;
+            muonPeakTime = std::max(muonPeakTime, peakTime);
+        }
+
+        size_t kept = 0;
+        for (size_t m = 0; m < fMuons.size(); m++) {
+            double muonTime = fMuons[m];
+            if (nsTime > muonTime + fWindow) continue; // Window closed without a Michel electron
+            bool paired = false;
+            for (int p = 0; p < kNumPMTs && !paired; p++) {
+                double michelTime = nsTime + pmtPeakTime[p];
+                if (michelTime >= muonTime && michelTime <= muonTime + fWindow) {
+                    dts.push_back(michelTime - muonTime);
+                    paired = true;
+                }
+            }
+            if (!paired) fMuons[kept++] = muonTime;
+        }
+        fMuons.resize(kept);
+
+        if (muonCandidate && muonPeakTime != -1) fMuons.push_back(nsTime + muonPeakTime);
+    }
+
+    // Muons still waiting for a Michel electron
+    size_t Pending() const { return fMuons.size(); }
+
+    void Clear() { fMuons.clear(); }
+
+    static double PeakTime(const Short_t *samples) {
+        double maxADC = -1, peakTime = -1;
+        for (int k = 0; k < 45; k++) {
+            if (samples[k] > maxADC) {
+                maxADC = samples[k];
+                peakTime = (k + 1) * 16.0;
+            }
+        }
+        return peakTime;
+    }
+
+private:
+    double fWindow;
+    std::vector<double> fMuons; // Times of the muons whose window is still open, in the order they were added
+};
+
+#endif
@@ -0,0 +1,60 @@
+//OccupancyAccumulator holds the streaming counters of the occupancy gain calibration of one PMT (occupancyGainCalibration.cpp).
+//The counters are stored in the occupancyCalibration tree, so the calibration of several shards or files is merged by adding them.
+#ifndef OCCUPANCYACCUMULATOR_H
+#define OCCUPANCYACCUMULATOR_H
+
+#include <Rtypes.h>
+#include <cmath>
+
+// Streaming occupancy counters of one PMT; accumulators of different files or threads can be merged
+struct OccupancyAccumulator {
+    Long64_t nEvents = 0;     // LED events
+    Long64_t nPedestal = 0;   // LED events with area below the pedestal threshold
+    double sumArea = 0;       // Sum of area over all LED events
+    double sumPedestal = 0;   // Sum of area over pedestal events
+
+    void Fill(double area, double pedestalThreshold) {
+        nEvents++;
+        sumArea += area;
+        if (area < pedestalThreshold) {
+            nPedestal++;
+            sumPedestal += area;
+        }
+    }
+
+    void Merge(const OccupancyAccumulator &other) {
+        nEvents += other.nEvents;
+        nPedestal += other.nPedestal;
+        sumArea += other.sumArea;
+        sumPedestal += other.sumPedestal;
+    }
+
+    // Mean number of photoelectrons per LED flash and its binomial uncertainty
+    double Lambda() const {
+        if (nEvents == 0 || nPedestal == 0) return -1;
+        return -log((double)nPedestal / nEvents);
+    }
+
+    double LambdaError() const {
+        if (nEvents == 0 || nPedestal == 0) return -1;
+        double p0 = (double)nPedestal / nEvents;
+        return sqrt((1 - p0) / (nEvents * p0));
+    }
+
+    // Gain in ADC counts per photoelectron
+    double Gain() const {
+        double lambda = Lambda();
+        if (lambda <= 0) return -1;
+        double pedestalMean = sumPedestal / nPedestal;
+        return (sumArea / nEvents - pedestalMean) / lambda;
+    }
+
+    // Dominant uncertainty of the gain: the relative uncertainty of lambda
+    double GainError() const {
+        double lambda = Lambda();
+        if (lambda <= 0) return -1;
+        return Gain() * LambdaError() / lambda;
+    }
+};
+
+#endif
@@ -0,0 +1,232 @@
+//RunFileIO.h sets up reading of the run files for all tools. The files sit on the NFS-mounted /data13, where a plain GetEntry loop
+//stalls on the network latency of every basket and decompresses on the analysis thread.
+//  InitRunFileIO()      - call once at the start of main: enables the ROOT thread pool (parallel basket decompression in
+//                         TTreeCacheUnzip and parallel branch reading in GetEntry) and the asynchronous prefetch thread of TFile.
+//  CacheActiveBranches() - call after SetBranchStatus (and again whenever the active branches change): creates the read-ahead
+//                         TTreeCache holding exactly the active branches, so each cache fill is one large sequential read.
+//
+//    InitRunFileIO();
+//    TFile *file = TFile::Open(fileName);
+//    TTree *tree = (TTree*)file->Get("tree");
+//    tree->SetBranchStatus("*", 0);
+//    tree->SetBranchStatus("area", 1);
+//    CacheActiveBranches(tree);
+//
+//The number of threads can be set with the environment variable RUNFILEIO_THREADS (0 = all cores, 1 = no thread pool).
+//
+//EntryRange is the shard of the tree a job processes (--entries begin:end, end exclusive); see makeShardManifest and mergeShards.
+//Tools that pair an event with earlier ones start reading at LeadInEntry(), before the range, and only count the events of the range.
+//PreviewRanges() gives the entry ranges of a spread-out subset of the clusters for a quick look (--preview FRACTION): only the baskets
+//of those clusters are read, and the histograms are scaled by the fraction of the entries actually read. Call
+//tree->SetCacheEntryRange(range.begin, range.end) before reading each range, or the cache prefetches the skipped clusters too.
+//The events of a cluster are correlated: uncertainties of a preview come from the spread between the sampled clusters.
+//JobIdentity is the input of a job (absolute path and size of the run file, entry range). Checkpointed tools write it into the
+//checkpoint and --resume refuses a checkpoint written for another file or range, e.g. by another shard in the same directory.
+//
+//Tools that process several run files in one process (--each) own every per-file object: histograms are kept out of gDirectory
+//(TH1::AddDirectory(kFALSE)) and deleted with their file. RSSMonitor prints the resident memory after every file and fails the
+//run when it keeps growing, so a leak shows up as an error instead of a job killed by the node after a few hundred runs.
+#ifndef RUNFILEIO_H
+#define RUNFILEIO_H
+
+#include <TROOT.h>
+#include <TEnv.h>
+#include <TTree.h>
+#include <TBranch.h>
+#include <TObjArray.h>
+#include <TTreeCacheUnzip.h>
+#include <TSystem.h>
+#include <TNamed.h>
+#include <TParameter.h>
+#include <TDirectory.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// Read-ahead cache per tree; large enough to hold several clusters of the active branches
+const Long64_t kRunFileCacheSize = 64 * 1024 * 1024;
+
+inline void InitRunFileIO(unsigned nThreads = 0) {
+    const char *env = getenv("RUNFILEIO_THREADS");
+    if (env) nThreads = atoi(env);
+
+    // Prefetch thread: the next cache block is read while the current one is processed. Must be set before the caches are created.
+    gEnv->SetValue("TFile.AsyncPrefetching", 1);
+
+    if (nThreads != 1 && !ROOT::IsImplicitMTEnabled()) {
+        ROOT::EnableImplicitMT(nThreads);
+        TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kEnable);
+    }
+}
+
+// Put the active branches of the tree (and only those) in its read-ahead cache
+inline void CacheActiveBranches(TTree *tree, Long64_t cacheSize = kRunFileCacheSize) {
+    tree->SetCacheSize(cacheSize);
+    tree->DropBranchFromCache("*", kTRUE);
+    TObjArray *branches = tree->GetListOfBranches();
+    for (int i = 0; i < branches->GetEntriesFast(); i++) {
+        TBranch *branch = (TBranch*)branches->At(i);
+        if (tree->GetBranchStatus(branch->GetName())) tree->AddBranchToCache(branch, kTRUE);
+    }
+    tree->StopCacheLearningPhase();
+}
+
+// Entries [begin, end) of the tree processed by a job; end < 0 means up to the last entry
+struct EntryRange {
+    Long64_t begin = 0;
+    Long64_t end = -1;
+};
+
+// Parse "begin:end" or "begin:" (to the last entry)
+inline bool ParseEntryRange(const char *text, EntryRange &range) {
+    long long begin, end;
+    if (sscanf(text, "%lld:%lld", &begin, &end) == 2 && begin >= 0 && end >= begin) {
+        range.begin = begin;
+        range.end = end;
+        return true;
+    }
+    char colon;
+    if (sscanf(text, "%lld%c", &begin, &colon) == 2 && colon == ':' && begin >= 0) {
+        range.begin = begin;
+        range.end = -1;
+        return true;
+    }
+    return false;
+}
+
+// Restrict the range to the entries of the tree
+inline void ClampEntryRange(EntryRange &range, Long64_t nEntries) {
+    if (range.end < 0 || range.end > nEntries) range.end = nEntries;
+    if (range.begin > range.end) range.begin = range.end;
+}
+
+// First entry to read so that the events up to spanNs before the first entry of the range are seen too: walks back from
+// range.begin until nsTime (whose branch address is nsTime) is more than spanNs earlier. The tree must be in time order.
+inline Long64_t LeadInEntry(TTree *tree, Long64_t &nsTime, const EntryRange &range, double spanNs) {
+    if (range.begin <= 0 || range.begin >= range.end) return range.begin;
+    TBranch *branch = tree->GetBranch("nsTime");
+    branch->GetEntry(range.begin);
+    double tBegin = nsTime;
+    Long64_t entry = range.begin;
+    while (entry > 0) {
+        branch->GetEntry(entry - 1);
+        if (nsTime < tBegin - spanNs) break;
+        entry--;
+    }
+    return entry;
+}
+
+// Input of a job, to tell its checkpoint from the checkpoints of other jobs
+struct JobIdentity {
+    TString path;       // Absolute path of the run file (as given if it cannot be resolved)
+    Long64_t size = -1; // File size in bytes
+    EntryRange range;   // Clamped entry range
+};
+
+inline JobIdentity MakeJobIdentity(const char *fileName, EntryRange range) {
+    JobIdentity job;
+    char *resolved = realpath(fileName, 0);
+    job.path = resolved ? resolved : fileName;
+    free(resolved);
+    struct stat st;
+    if (stat(fileName, &st) == 0) job.size = st.st_size;
+    job.range = range;
+    return job;
+}
+
+// Write the identity into the current directory
+inline void WriteJobIdentity(const JobIdentity &job) {
+    TNamed("inputFile", job.path.Data()).Write();
+    TParameter<Long64_t>("inputSize", job.size).Write();
+    TParameter<Long64_t>("rangeBegin", job.range.begin).Write();
+    TParameter<Long64_t>("rangeEnd", job.range.end).Write();
+}
+
+// Whether dir holds the identity of job; prints what differs if not
+inline bool CheckJobIdentity(TDirectory *dir, const JobIdentity &job) {
+    TNamed *path = (TNamed*)dir->Get("inputFile");
+    TParameter<Long64_t> *size = (TParameter<Long64_t>*)dir->Get("inputSize");
+    TParameter<Long64_t> *begin = (TParameter<Long64_t>*)dir->Get("rangeBegin");
+    TParameter<Long64_t> *end = (TParameter<Long64_t>*)dir->Get("rangeEnd");
+    if (!path || !size || !begin || !end) {
+        fprintf(stderr, "Error: the checkpoint does not record its input file\n");
+        return false;
+    }
+    if (job.path != path->GetTitle() || job.size != size->GetVal() || job.range.begin != begin->GetVal() ||
+        job.range.end != end->GetVal()) {
+        fprintf(stderr, "Error: the checkpoint belongs to %s (%lld bytes, entries %lld:%lld), not to %s (%lld bytes, entries %lld:%lld)\n",
+                path->GetTitle(), (long long)size->GetVal(), (long long)begin->GetVal(), (long long)end->GetVal(),
+                job.path.Data(), (long long)job.size, (long long)job.range.begin, (long long)job.range.end);
+        return false;
+    }
+    return true;
+}
+
+// Ranges to read for a preview of about fraction of the entries: every cluster (entries whose baskets are written together)
+// is taken or skipped as a whole, and the taken clusters are spread uniformly over the run. fraction >= 1 is the whole tree.
+inline std::vector<EntryRange> PreviewRanges(TTree *tree, double fraction) {
+    Long64_t nEntries = tree->GetEntries();
+    std::vector<EntryRange> ranges;
+    if (fraction >= 1) {
+        EntryRange all;
+        all.end = nEntries;
+        ranges.push_back(all);
+        return ranges;
+    }
+
+    std::vector<EntryRange> clusters;
+    TTree::TClusterIterator clusterIter = tree->GetClusterIterator(0);
+    for (Long64_t start = clusterIter.Next(); start < nEntries; start = clusterIter.Next()) {
+        EntryRange cluster;
+        cluster.begin = start;
+        cluster.end = std::min(clusterIter.GetNextEntry(), nEntries);
+        clusters.push_back(cluster);
+    }
+    for (size_t i = 0; i < clusters.size(); i++) {
+        if (floor((i + 1) * fraction) > floor(i * fraction)) ranges.push_back(clusters[i]);
+    }
+    if (ranges.empty() && !clusters.empty()) ranges.push_back(clusters[clusters.size() / 2]);
+    return ranges;
+}
+
+// Resident set size of the process in MB
+inline double ResidentMemoryMB() {
+    ProcInfo_t info;
+    gSystem->GetProcInfo(&info);
+    return info.fMemResident / 1024.;
+}
+
+// RSS over the files of a multi-file run. The first warmupFiles files load dictionaries, caches and the fit minimizer;
+// after them the RSS may not grow by more than limitMB (limitMB <= 0: only print).
+class RSSMonitor {
+public:
+    RSSMonitor(double limitMB, int warmupFiles = 3)
+        : fLimitMB(limitMB), fWarmupFiles(warmupFiles), fFiles(0), fBaselineMB(0), fMaxGrowthMB(0) {}
+
+    // Call after the objects of a file are deleted; returns false if the growth exceeds the limit
+    bool FileDone(const char *fileName) {
+        double rss = ResidentMemoryMB();
+        fFiles++;
+        if (fFiles <= fWarmupFiles) fBaselineMB = rss;
+        double growth = rss - fBaselineMB;
+        fMaxGrowthMB = std::max(fMaxGrowthMB, growth);
+        printf("RSS after file %d (%s): %.1f MB, %+.1f MB since warm-up\n", fFiles, fileName, rss, growth);
+        if (fLimitMB > 0 && growth > fLimitMB) {
+            fprintf(stderr, "Error: RSS grew by %.1f MB after %d files (limit %.1f MB)\n", growth, fFiles, fLimitMB);
+            return false;
+        }
+        return true;
+    }
+
+    double MaxGrowthMB() const { return fMaxGrowthMB; }
+
+private:
+    double fLimitMB;
+    int fWarmupFiles, fFiles;
+    double fBaselineMB, fMaxGrowthMB;
+};
+
+#endif
@@ -1,17 +1,29 @@
+//This code fills the area histograms of low light (triggerBits==16) events of the 12 PMTs and fits them with the SPE function.
+//The histograms with their fits, a fitResults tree and the combined-canvas layout are written to a results file;
+//the plots are drawn from it by renderResults, so layout changes do not rerun the event loop or the fits.
+//--preview FRACTION reads only a spread-out subset of the clusters for a quick look (the read-ahead cache is limited to each sampled
+//cluster, so the skipped ones are not read): the fits are done on the sample and the histograms (with their fits) are scaled up to
+//the whole run. Events of one cluster are not independent (same period of the run), so besides the fit error the printed mu1 has
+//the spread between clusters: the sampled clusters are dealt into up to 8 groups and the fit is repeated without each group
+//(delete-a-group jackknife).
+//--each processes every file given in one process, each into spe_<run file name>; the RSS is checked after every file
+//(--rss-limit MB, see RunFileIO.h), e.g. ./SinglePEfitGaussian --each /data13/.../run2*_processed_v5.root
 #include <iostream>
 #include <TFile.h>
 #include <TTree.h>
 #include <TH1F.h>
-#include <TCanvas.h>
 #include <TF1.h>
-#include <TPaveStats.h>
-#include <TLatex.h>
+#include <TParameter.h>
+#include <TVectorD.h>
 #include <TSystem.h>
-#include <TStyle.h>
-#include <TROOT.h>
+#include "FastHist.h"
+#include "DetectorGeometry.h"
+#include "RunFileIO.h"
 #include <vector>
+#include <string>
 #include <algorithm>
 #include <cmath>
+#include <cstdlib>
 
 using namespace std;
 
@@ -30,14 +42,12 @@ Double_t SPEfit(Double_t *x, Double_t *par) {
     return term1 + term2 + term3 + term4;
 }
 
-void processLowLightEvents(const char *fileName) {
-    // Create output directory
-    gSystem->mkdir("plots", kTRUE);
-
+void processLowLightEvents(const char *fileName, const char *resultsName, double previewFraction) {
     // Open the ROOT file
     TFile *file = TFile::Open(fileName);
     if (!file || file->IsZombie()) {
         cerr << "Error opening file: " << fileName << endl;
+        delete file;
         return;
     }
 
@@ -46,6 +56,7 @@ void processLowLightEvents(const char *fileName) {
     if (!tree) {
         cerr << "Error accessing TTree 'tree'!" << endl;
         file->Close();
+        delete file;
         return;
     }
 
@@ -56,15 +67,60 @@ void processLowLightEvents(const char *fileName) {
     tree->SetBranchAddress("adcVal", adcVal);
     tree->SetBranchAddress("area", area);
     tree->SetBranchAddress("triggerBits", &triggerBits);
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("area", 1);
+    tree->SetBranchStatus("triggerBits", 1);
+    CacheActiveBranches(tree);
 
     Long64_t nEntries = tree->GetEntries();
 
-    // Prepare histograms
+    // Whole run, or a spread-out subset of its clusters in preview mode
+    vector<EntryRange> ranges = PreviewRanges(tree, previewFraction);
+    int nGroups = (previewFraction < 1) ? (int)min<size_t>(8, ranges.size()) : 1; // Cluster groups of the jackknife
+    if (nGroups < 2) nGroups = 1;
+
+    // Fill lightweight histograms in the event loop, one set per group of clusters
+    vector<FastHist> areaFill;
+    areaFill.reserve(12 * nGroups);
+    for (int g = 0; g < nGroups; g++) {
+        for (int i = 0; i < 12; i++) {
+            areaFill.emplace_back(Form("PMT%d_Area", i+1), Form("; Area; Events per 3 ADCs", i+1), 150, -50, 400);
+        }
+    }
+
+    // LED event areas are collected in physical order, then every PMT histogram is filled from one contiguous array
+    PhysicalBlock<Double_t> ledAreas;
+    auto fillBlock = [&](int g) {
+        ForEachChannel<kPMTChannel>([&](int p) { areaFill[g * 12 + p].FillN(ledAreas.Channel(p), ledAreas.Size()); });
+        ledAreas.Clear();
+    };
+
+    Long64_t nRead = 0;
+    for (size_t r = 0; r < ranges.size(); r++) {
+        int g = r % nGroups;
+        tree->SetCacheEntryRange(ranges[r].begin, ranges[r].end); // Prefetch only this cluster
+        for (Long64_t ev = ranges[r].begin; ev < ranges[r].end; ++ev) {
+            tree->GetEntry(ev);
+            if (triggerBits == 16) {
+                ledAreas.Add(area);
+                if (ledAreas.Full()) fillBlock(g);
+            }
+        }
+        fillBlock(g);
+        nRead += ranges[r].end - ranges[r].begin;
+    }
+    for (int g = 1; g < nGroups; g++) {
+        for (int i = 0; i < 12; i++) areaFill[i].Add(areaFill[g * 12 + i]);
+    }
+    double sampledFraction = (nEntries > 0) ? (double)nRead / nEntries : 1;
+    if (previewFraction < 1) {
+        cout << "Preview: read " << nRead << " of " << nEntries << " entries (" << 100 * sampledFraction << "%)" << endl;
+    }
+
+    // Convert to TH1F for fitting and drawing
     TH1F *histArea[12];
     for (int i = 0; i < 12; i++) {
-        histArea[i] = new TH1F(Form("PMT%d_Area", i+1),
-                               Form("; Area; Events per 3 ADCs", i+1),
-                               150, -50, 400);
+        histArea[i] = areaFill[i].ToTH1F();
         histArea[i]->SetLineColor(kRed);
         histArea[i]->GetXaxis()->SetLabelFont(42);
         histArea[i]->GetYaxis()->SetLabelFont(42);
@@ -72,156 +128,140 @@ void processLowLightEvents(const char *fileName) {
         histArea[i]->GetYaxis()->SetTitleFont(42);
     }
 
-    int pmtChannelMap[12] = {0,10,7,2,6,3,8,9,11,4,5,1};
-
-    // Fill histograms
-    for (Long64_t ev = 0; ev < nEntries; ++ev) {
-        tree->GetEntry(ev);
-        if (triggerBits == 16) {
-            for (int p = 0; p < 12; ++p) {
-                histArea[p]->Fill(area[pmtChannelMap[p]]);
-            }
-        }
-    }
+    // Fit every PMT once and keep the fit with its histogram
+    Int_t pmtNumber;
+    Double_t params[8], errors[8], chi2;
+    Int_t ndf;
+    TTree *fitTree = new TTree("fitResults", "SPE fit results");
+    fitTree->SetDirectory(0);
+    fitTree->Branch("pmt", &pmtNumber, "pmt/I");
+    fitTree->Branch("params", params, "params[8]/D");
+    fitTree->Branch("errors", errors, "errors[8]/D");
+    fitTree->Branch("chi2", &chi2, "chi2/D");
+    fitTree->Branch("ndf", &ndf, "ndf/I");
 
-    // (1) Draw individual histograms as before…
-    TCanvas *canvas = new TCanvas("canvas","PMT Energy Distributions",1200,800);
-    canvas->SetLeftMargin(0.15);
-    canvas->SetRightMargin(0.05);
-    canvas->SetBottomMargin(0.15);
-    canvas->SetTopMargin(0.05);
     for (int i = 0; i < 12; ++i) {
-        canvas->Clear();
-        histArea[i]->GetXaxis()->SetTitleSize(0.05);
-        histArea[i]->GetYaxis()->SetTitleSize(0.05);
-        histArea[i]->GetXaxis()->SetLabelSize(0.04);
-        histArea[i]->GetYaxis()->SetLabelSize(0.04);
-
         TF1 *f = new TF1("f", SPEfit, -50, 400, 8);
         f->SetParameters(1000,0,10,1000,50,10,500,500);
         f->SetLineColor(kBlue);
         f->SetParNames("A0","#mu_{0}","#sigma_{0}","A1","#mu_{1}","#sigma_{1}","A2","A3");
 
-        histArea[i]->Fit(f,"R");
-        histArea[i]->Draw();
-        f->Draw("same");
-
-        TLatex tex;
-        tex.SetTextFont(42);
-        tex.SetTextSize(0.06);
-        tex.SetTextAlign(22);
-        tex.SetNDC();
-        tex.DrawLatex(0.5, 0.92, Form("PMT %d", i+1));
-
-        gPad->Update();
-        if (auto stats = (TPaveStats*)histArea[i]->FindObject("stats")) {
-            stats->SetX1NDC(0.65); stats->SetY1NDC(0.65);
-            stats->SetX2NDC(0.95); stats->SetY2NDC(0.95);
-            stats->SetTextFont(42);
-            stats->SetTextSize(0.03);
-            stats->SetOptStat(10);
-            stats->SetOptFit(111);
-            stats->SetName("");
+        // Fit without drawing, but keep the stored function drawable for the renderer
+        histArea[i]->Fit(f,"R0");
+        if (TF1 *stored = histArea[i]->GetFunction("f")) stored->ResetBit(TF1::kNotDraw);
+        pmtNumber = i + 1;
+        for (int p = 0; p < 8; p++) {
+            params[p] = f->GetParameter(p);
+            errors[p] = f->GetParError(p);
         }
-
-        canvas->SaveAs(Form("plots/PMT%d_Energy_Distribution.png", i+1));
+        chi2 = f->GetChisquare();
+        ndf = f->GetNDF();
+        fitTree->Fill();
+        cout << "PMT " << i+1 << ": mu1 = " << params[4] << " +/- " << errors[4] << " (fit)";
+        if (nGroups > 1) {
+            // Jackknife over the cluster groups: the fit without group g, starting from the fit of the whole sample
+            vector<double> mu1WithoutGroup(nGroups);
+            double mean = 0;
+            for (int g = 0; g < nGroups; g++) {
+                TH1F *part = areaFill[i].ToTH1F("jackknife");
+                for (int bin = 0; bin <= part->GetNbinsX() + 1; bin++) {
+                    part->SetBinContent(bin, (double)(areaFill[i].GetBinContent(bin) - areaFill[g * 12 + i].GetBinContent(bin)));
+                }
+                part->ResetStats();
+                TF1 *fg = new TF1("fg", SPEfit, -50, 400, 8);
+                fg->SetParameters(params);
+                part->Fit(fg, "RQ0N");
+                mu1WithoutGroup[g] = fg->GetParameter(4);
+                mean += mu1WithoutGroup[g] / nGroups;
+                delete fg;
+                delete part;
+            }
+            double variance = 0;
+            for (int g = 0; g < nGroups; g++) variance += pow(mu1WithoutGroup[g] - mean, 2);
+            variance *= (nGroups - 1.0) / nGroups;
+            cout << " +/- " << sqrt(variance) << " (between " << nGroups << " cluster groups)";
+        }
+        cout << endl;
         delete f;
     }
-    delete canvas;
-
-    // (2) Create the master canvas with double resolution and vector exports
-    //    → Sharp PDF text + high‐res PNG
-    gStyle->SetTextFont(42);
-    gStyle->SetLabelFont(42, "XYZ");
-    gStyle->SetTitleFont(42, "XYZ");
-
-    // Increase export resolution by factor 2
-    gStyle->SetImageScaling(2.0);
-
-    TCanvas *master = new TCanvas("MasterCanvas",
-                                  "Combined PMT Energy Distributions",
-                                  2400, 1600);
-    master->Divide(3,4,0,0);
-    int layout[4][3] = {
-        {0,10,7},
-        {2,6,3},
-        {8,9,11},
-        {4,5,1}
-    };
 
-    for (int r = 0; r < 4; ++r) {
-      for (int c = 0; c < 3; ++c) {
-        int pad = r*3 + c + 1;
-        master->cd(pad);
-
-        int idx = layout[r][c];
-        histArea[idx]->GetXaxis()->SetTitleSize(0.07);
-        histArea[idx]->GetYaxis()->SetTitleSize(0.09);
-        histArea[idx]->GetXaxis()->SetLabelSize(0.04);
-        histArea[idx]->GetYaxis()->SetLabelSize(0.04);
-        histArea[idx]->GetYaxis()->SetTitle("Events per 3 ADCs");
-        histArea[idx]->GetYaxis()->SetTitleOffset(0.8);
-        histArea[idx]->GetXaxis()->SetTitle("Area");
-    
-
-        gPad->SetLeftMargin(0.15);
-        gPad->SetRightMargin(0.12);
-        gPad->SetBottomMargin(0.15);
-        gPad->SetTopMargin(0.10);
-
-        TF1 *f2 = new TF1("f2", SPEfit, -50, 400, 8);
-        f2->SetParameters(100,0,10,100,50,10,50,50);
-        f2->SetLineColor(kBlue);
-        f2->SetParNames("A0","#mu_{0}","#sigma_{0}",
-                        "A1","#mu_{1}","#sigma_{1}","A2","A3");
-
-        histArea[idx]->Fit(f2,"R");
-        histArea[idx]->Draw();
-        f2->Draw("same");
-
-        TLatex tex2;
-        tex2.SetTextFont(42);
-        tex2.SetTextSize(0.14);
-        tex2.SetTextAlign(22);
-        tex2.SetNDC();
-        tex2.DrawLatex(0.5, 0.92, Form("PMT %d", idx+1));
-
-        gPad->Update();
-        if (auto s2 = (TPaveStats*)histArea[idx]->FindObject("stats")) {
-          s2->SetX1NDC(0.65); s2->SetY1NDC(0.65);
-          s2->SetX2NDC(0.95); s2->SetY2NDC(0.95);
-          s2->SetTextFont(42);
-          s2->SetTextSize(0.03);
-          s2->SetOptStat(10);
-          s2->SetOptFit(111);
-          s2->SetName("");
+    // Preview: scale the histograms and the amplitudes (A0, A1, A2, A3) of their fits to the whole run
+    if (sampledFraction < 1 && sampledFraction > 0) {
+        for (int i = 0; i < 12; ++i) {
+            histArea[i]->Scale(1.0 / sampledFraction);
+            if (TF1 *stored = histArea[i]->GetFunction("f")) {
+                int amplitudes[4] = {0, 3, 6, 7};
+                for (int a = 0; a < 4; a++) {
+                    stored->SetParameter(amplitudes[a], stored->GetParameter(amplitudes[a]) / sampledFraction);
+                }
+            }
         }
-
-        delete f2;
-      }
     }
 
-    // Export sharp text
-    master->SaveAs("plots/Combined_PMT_Energy_Distributions.pdf");
-    master->SaveAs("plots/Combined_PMT_Energy_Distributions.png");
-
-    // Restore default scaling
-    gStyle->SetImageScaling(1.0);
+    // Write histograms, fits and the combined-canvas layout (physical location of the PMTs) for renderResults
+    TVectorD layoutVec(kPMTDisplayRows * kPMTDisplayCols);
+    for (int r = 0; r < kPMTDisplayRows; ++r)
+        for (int c = 0; c < kPMTDisplayCols; ++c) layoutVec[r * kPMTDisplayCols + c] = PMTDisplaySlot(r, c);
+
+    TFile *results = new TFile(resultsName, "RECREATE");
+    if (!results || results->IsZombie()) {
+        cerr << "Error creating results file: " << resultsName << endl;
+        delete results;
+        for (int i = 0; i < 12; ++i) delete histArea[i];
+        delete fitTree;
+        file->Close();
+        delete file;
+        return;
+    }
+    for (int i = 0; i < 12; ++i) histArea[i]->Write();
+    fitTree->Write();
+    TParameter<Double_t>("sampledFraction", sampledFraction).Write();
+    TNamed("resultKind", "spe").Write();
+    TParameter<Int_t>("layoutRows", kPMTDisplayRows).Write();
+    TParameter<Int_t>("layoutCols", kPMTDisplayCols).Write();
+    layoutVec.Write("layout");
+    results->Close();
+    delete results;
 
     // Cleanup
     for (int i = 0; i < 12; ++i) delete histArea[i];
-    delete master;
+    delete fitTree;
     file->Close();
+    delete file;
 
-    cout << "Plots saved under 'plots/'. "
-         << "Vector text in PDF + high‐res PNG available." << endl;
+    cout << "Histograms and fits saved in " << resultsName
+         << ". Draw them with: renderResults " << resultsName << " plots" << endl;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " <root_file>" << endl;
+    double previewFraction = 1, rssLimit = 50;
+    bool each = false;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--preview" && i + 1 < argc) previewFraction = atof(argv[++i]);
+        else if (arg == "--each") each = true;
+        else if (arg == "--rss-limit" && i + 1 < argc) rssLimit = atof(argv[++i]);
+        else args.push_back(argv[i]);
+    }
+    if (args.size() < 1 || (!each && args.size() > 2) || previewFraction <= 0) {
+        cerr << "Usage: " << argv[0] << " <root_file> [results.root] [--preview FRACTION]" << endl;
+        cerr << "       " << argv[0] << " --each <root_file...> [--rss-limit MB] [--preview FRACTION]" << endl;
         return 1;
     }
-    processLowLightEvents(argv[1]);
+    InitRunFileIO();
+    TH1::AddDirectory(kFALSE); // The histograms belong to this code, not to the input file
+    if (!each) {
+        processLowLightEvents(args[0], (args.size() == 2) ? args[1] : "spe_results.root", previewFraction);
+        return 0;
+    }
+
+    RSSMonitor rss(rssLimit);
+    for (size_t f = 0; f < args.size(); f++) {
+        TString resultsName = TString("spe_") + gSystem->BaseName(args[f]);
+        processLowLightEvents(args[f], resultsName, previewFraction);
+        if (!rss.FileDone(args[f])) return 1;
+    }
+    cout << args.size() << " files processed, largest RSS growth after warm-up " << rss.MaxGrowthMB() << " MB" << endl;
     return 0;
 }
@@ -0,0 +1,309 @@
+//IntervalAccumulator holds the streaming statistics of one nsTime interval of a run (timeSeriesMonitor.cpp): the number of events with
+//each triggerBits bit set and the sums of baselineMean and baselineRMS of the 23 channels. Its size does not depend on the number of
+//events, and the accumulators of the same interval from different threads, shards or files are merged by adding them.
+//The raw sums are stored in the timeSeries tree, so the rates and the mean baselines can be recomputed after merging.
+//TimeSeries is the list of intervals of a run on a grid that starts at nsTime 0, so the intervals of the shards of a run line up:
+//mergeShards merges them interval by interval with TimeSeries::Merge, flags the merged intervals against the whole run
+//(FlagIntervals) and writes them again with WriteTimeSeries, which also rebuilds goodEntries from the entry segments of the shards.
+#ifndef TIMESERIESACCUMULATOR_H
+#define TIMESERIESACCUMULATOR_H
+
+#include <Rtypes.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TEntryList.h>
+#include <TParameter.h>
+#include <TDirectory.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Bits of the flag word of an interval
+enum IntervalFlag {
+    kFlagEmpty         = 1 << 0, // No events although the run continues (DAQ dead time)
+    kFlagTriggerRate   = 1 << 1, // The rate of a triggerBits bit is off
+    kFlagBaselineMean  = 1 << 2, // The mean baseline of a channel moved
+    kFlagBaselineNoise = 1 << 3  // The mean baseline RMS of a channel is off (noise burst)
+};
+
+struct IntervalAccumulator {
+    Long64_t nEvents = 0;
+    Long64_t triggerCounts[32] = {0};     // Events with triggerBits bit b set
+    double baselineMeanSum[23] = {0}, baselineMeanSum2[23] = {0};
+    double baselineRMSSum[23] = {0}, baselineRMSSum2[23] = {0};
+    double baselineRMSMax[23] = {0};
+    Long64_t entryFirst = -1, entryLast = -1; // Entries of the interval (the tree is time ordered)
+
+    void Fill(Long64_t entry, Int_t triggerBits, const Double_t *baselineMean, const Double_t *baselineRMS) {
+        nEvents++;
+        for (int b = 0; b < 32; b++) {
+            if (triggerBits & (1u << b)) triggerCounts[b]++;
+        }
+        for (int ch = 0; ch < 23; ch++) {
+            baselineMeanSum[ch] += baselineMean[ch];
+            baselineMeanSum2[ch] += baselineMean[ch] * baselineMean[ch];
+            baselineRMSSum[ch] += baselineRMS[ch];
+            baselineRMSSum2[ch] += baselineRMS[ch] * baselineRMS[ch];
+            baselineRMSMax[ch] = std::max(baselineRMSMax[ch], baselineRMS[ch]);
+        }
+        if (entryFirst < 0 || entry < entryFirst) entryFirst = entry;
+        entryLast = std::max(entryLast, entry);
+    }
+
+    void Merge(const IntervalAccumulator &other) {
+        nEvents += other.nEvents;
+        for (int b = 0; b < 32; b++) triggerCounts[b] += other.triggerCounts[b];
+        for (int ch = 0; ch < 23; ch++) {
+            baselineMeanSum[ch] += other.baselineMeanSum[ch];
+            baselineMeanSum2[ch] += other.baselineMeanSum2[ch];
+            baselineRMSSum[ch] += other.baselineRMSSum[ch];
+            baselineRMSSum2[ch] += other.baselineRMSSum2[ch];
+            baselineRMSMax[ch] = std::max(baselineRMSMax[ch], other.baselineRMSMax[ch]);
+        }
+        if (other.entryFirst >= 0 && (entryFirst < 0 || other.entryFirst < entryFirst)) entryFirst = other.entryFirst;
+        entryLast = std::max(entryLast, other.entryLast);
+    }
+
+    double BaselineMean(int ch) const { return nEvents ? baselineMeanSum[ch] / nEvents : 0; }
+    double BaselineRMS(int ch) const { return nEvents ? baselineRMSSum[ch] / nEvents : 0; }
+};
+
+// Entries [first, last] of the tree that went to one interval. Consecutive entries of the same interval share a segment, so a
+// time-ordered tree has about one segment per interval.
+struct EntrySegment {
+    Long64_t first, last;
+    Long64_t interval; // Index on the grid (TimeSeries::IndexOf)
+};
+
+// Interval i covers nsTime [(firstInterval + i) x intervalSeconds, (firstInterval + i + 1) x intervalSeconds)
+struct TimeSeries {
+    double intervalSeconds = 1;
+    Long64_t firstInterval = 0;
+    Long64_t nsTimeFirst = 0, nsTimeLast = 0; // First and last accepted event
+    std::vector<IntervalAccumulator> intervals;
+    std::vector<EntrySegment> segments;
+
+    Long64_t IndexOf(Long64_t nsTime) const { return (Long64_t)floor(nsTime / (intervalSeconds * 1e9)); }
+
+    // Live time of interval i in seconds; the first and the last interval end at the first and the last event
+    double Duration(size_t i) const {
+        double length = intervalSeconds * 1e9;
+        double start = std::max((firstInterval + (Long64_t)i) * length - nsTimeFirst, 0.0);
+        double end = std::min((firstInterval + (Long64_t)i + 1) * length - nsTimeFirst, (double)(nsTimeLast - nsTimeFirst));
+        return std::max((end - start) / 1e9, 1e-9);
+    }
+
+    // Add the intervals of another part of the run (same intervalSeconds); the intervals between the two stay empty
+    void Merge(const TimeSeries &other) {
+        if (other.intervals.empty()) return;
+        if (intervals.empty()) {
+            *this = other;
+            return;
+        }
+        Long64_t first = std::min(firstInterval, other.firstInterval);
+        Long64_t last = std::max(firstInterval + (Long64_t)intervals.size(), other.firstInterval + (Long64_t)other.intervals.size());
+        std::vector<IntervalAccumulator> merged(last - first);
+        for (size_t i = 0; i < intervals.size(); i++) merged[firstInterval - first + i].Merge(intervals[i]);
+        for (size_t i = 0; i < other.intervals.size(); i++) merged[other.firstInterval - first + i].Merge(other.intervals[i]);
+        intervals.swap(merged);
+        firstInterval = first;
+        nsTimeFirst = std::min(nsTimeFirst, other.nsTimeFirst);
+        nsTimeLast = std::max(nsTimeLast, other.nsTimeLast);
+        segments.insert(segments.end(), other.segments.begin(), other.segments.end());
+    }
+};
+
+// Median and robust standard deviation (1.4826 x median absolute deviation)
+inline void RobustStats(std::vector<double> values, double &median, double &sigma) {
+    median = sigma = 0;
+    if (values.empty()) return;
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    median = values[values.size() / 2];
+    for (size_t i = 0; i < values.size(); i++) values[i] = fabs(values[i] - median);
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    sigma = 1.4826 * values[values.size() / 2];
+}
+
+inline bool IsOutlier(double value, double median, double sigma, double statError, double nSigma) {
+    return fabs(value - median) > nSigma * std::max(std::max(sigma, statError), 1e-9);
+}
+
+// Flag the intervals against the whole series: empty intervals, and a trigger bit rate, mean baseline or baseline RMS of a channel
+// more than nSigma robust standard deviations (at least the statistical error of the interval) from the median of the series
+inline void FlagIntervals(const TimeSeries &series, double nSigma, std::vector<UInt_t> &flags, std::vector<UInt_t> &badChannels) {
+    size_t nIntervals = series.intervals.size();
+    flags.assign(nIntervals, 0);
+    badChannels.assign(nIntervals, 0);
+    // Reference intervals: at least half of the full length and not empty
+    std::vector<size_t> reference;
+    for (size_t i = 0; i < nIntervals; i++) {
+        if (series.intervals[i].nEvents == 0) flags[i] |= kFlagEmpty;
+        else if (series.Duration(i) >= 0.5 * series.intervalSeconds) reference.push_back(i);
+    }
+
+    // Trigger rates of the bits that occur in the run
+    for (int b = 0; b < 32; b++) {
+        std::vector<double> rates;
+        for (size_t r = 0; r < reference.size(); r++) {
+            rates.push_back(series.intervals[reference[r]].triggerCounts[b] / series.Duration(reference[r]));
+        }
+        double median, sigma;
+        RobustStats(rates, median, sigma);
+        if (median <= 0) continue;
+        for (size_t r = 0; r < reference.size(); r++) {
+            double duration = series.Duration(reference[r]);
+            double poissonError = sqrt(median * duration) / duration;
+            if (IsOutlier(rates[r], median, sigma, poissonError, nSigma)) flags[reference[r]] |= kFlagTriggerRate;
+        }
+    }
+
+    // Baselines of every channel
+    for (int ch = 0; ch < 23; ch++) {
+        std::vector<double> means, noises;
+        for (size_t r = 0; r < reference.size(); r++) {
+            means.push_back(series.intervals[reference[r]].BaselineMean(ch));
+            noises.push_back(series.intervals[reference[r]].BaselineRMS(ch));
+        }
+        double meanMedian, meanSigma, noiseMedian, noiseSigma;
+        RobustStats(means, meanMedian, meanSigma);
+        RobustStats(noises, noiseMedian, noiseSigma);
+        for (size_t r = 0; r < reference.size(); r++) {
+            const IntervalAccumulator &acc = series.intervals[reference[r]];
+            double n = acc.nEvents;
+            double meanError = sqrt(std::max(acc.baselineMeanSum2[ch] / n - means[r] * means[r], 0.0) / n);
+            double noiseError = sqrt(std::max(acc.baselineRMSSum2[ch] / n - noises[r] * noises[r], 0.0) / n);
+            UInt_t channelBit = 1u << ch;
+            if (IsOutlier(means[r], meanMedian, meanSigma, meanError, nSigma)) {
+                flags[reference[r]] |= kFlagBaselineMean;
+                badChannels[reference[r]] |= channelBit;
+            }
+            if (IsOutlier(noises[r], noiseMedian, noiseSigma, noiseError, nSigma)) {
+                flags[reference[r]] |= kFlagBaselineNoise;
+                badChannels[reference[r]] |= channelBit;
+            }
+        }
+    }
+}
+
+// Objects WriteTimeSeries writes; mergeShards merges them together instead of one by one
+const char *const kTimeSeriesObjects[] = {"timeSeries", "intervalEntries", "goodEntries", "eventRate", "flaggedRate",
+                                          "intervalSeconds", "nSigma", "nsTimeFirst", "nsTimeLast"};
+
+// Write the series into the current directory: tree "timeSeries" (one entry per interval: the raw sums, flags and badChannels),
+// tree "intervalEntries" (the entry segments), goodEntries with the entries of the unflagged intervals, and the event rate
+// histograms "eventRate" and "flaggedRate". Prints the flagged intervals; returns the number of good entries.
+inline Long64_t WriteTimeSeries(const TimeSeries &series, const std::vector<UInt_t> &flags, const std::vector<UInt_t> &badChannels,
+                                double nSigma, TEntryList *goodEntries) {
+    size_t nIntervals = series.intervals.size();
+    IntervalAccumulator row;
+    Long64_t intervalIndex;
+    Double_t tStart, length;
+    UInt_t flagWord, channelMask;
+    TTree *seriesTree = new TTree("timeSeries", "Baselines and trigger rates per nsTime interval");
+    seriesTree->Branch("interval", &intervalIndex, "interval/L");
+    seriesTree->Branch("tStart", &tStart, "tStart/D");
+    seriesTree->Branch("duration", &length, "duration/D");
+    seriesTree->Branch("nEvents", &row.nEvents, "nEvents/L");
+    seriesTree->Branch("triggerCounts", row.triggerCounts, "triggerCounts[32]/L");
+    seriesTree->Branch("baselineMeanSum", row.baselineMeanSum, "baselineMeanSum[23]/D");
+    seriesTree->Branch("baselineMeanSum2", row.baselineMeanSum2, "baselineMeanSum2[23]/D");
+    seriesTree->Branch("baselineRMSSum", row.baselineRMSSum, "baselineRMSSum[23]/D");
+    seriesTree->Branch("baselineRMSSum2", row.baselineRMSSum2, "baselineRMSSum2[23]/D");
+    seriesTree->Branch("baselineRMSMax", row.baselineRMSMax, "baselineRMSMax[23]/D");
+    seriesTree->Branch("entryFirst", &row.entryFirst, "entryFirst/L");
+    seriesTree->Branch("entryLast", &row.entryLast, "entryLast/L");
+    seriesTree->Branch("flags", &flagWord, "flags/i");
+    seriesTree->Branch("badChannels", &channelMask, "badChannels/i");
+
+    TH1F *rateHist = new TH1F("eventRate", "Event rate;Time since the start of the first interval [s];Rate [Hz]", nIntervals, 0,
+                              nIntervals * series.intervalSeconds);
+    TH1F *flaggedHist = (TH1F*)rateHist->Clone("flaggedRate");
+    for (size_t i = 0; i < nIntervals; i++) {
+        row = series.intervals[i];
+        intervalIndex = series.firstInterval + i;
+        tStart = i * series.intervalSeconds;
+        length = series.Duration(i);
+        flagWord = flags[i];
+        channelMask = badChannels[i];
+        seriesTree->Fill();
+
+        rateHist->SetBinContent(i + 1, row.nEvents / length);
+        if (flags[i]) {
+            flaggedHist->SetBinContent(i + 1, row.nEvents / length);
+            printf("Interval %lld (%g-%g s): flags 0x%x, channels 0x%x\n", (long long)intervalIndex, tStart, tStart + length,
+                   flags[i], badChannels[i]);
+        }
+    }
+
+    EntrySegment segment;
+    TTree *segmentTree = new TTree("intervalEntries", "Entries of the tree per interval");
+    segmentTree->Branch("first", &segment.first, "first/L");
+    segmentTree->Branch("last", &segment.last, "last/L");
+    segmentTree->Branch("interval", &segment.interval, "interval/L");
+    Long64_t nGood = 0;
+    for (size_t s = 0; s < series.segments.size(); s++) {
+        segment = series.segments[s];
+        segmentTree->Fill();
+        if (flags[segment.interval - series.firstInterval]) continue;
+        for (Long64_t entry = segment.first; entry <= segment.last; entry++) goodEntries->Enter(entry);
+        nGood += segment.last - segment.first + 1;
+    }
+
+    seriesTree->Write();
+    segmentTree->Write();
+    goodEntries->Write();
+    rateHist->Write();
+    flaggedHist->Write();
+    TParameter<Double_t>("intervalSeconds", series.intervalSeconds).Write();
+    TParameter<Double_t>("nSigma", nSigma).Write();
+    TParameter<Long64_t>("nsTimeFirst", series.nsTimeFirst).Write();
+    TParameter<Long64_t>("nsTimeLast", series.nsTimeLast).Write();
+    return nGood;
+}
+
+// Read a series written by WriteTimeSeries; false if dir does not hold one
+inline bool ReadTimeSeries(TDirectory *dir, TimeSeries &series, double &nSigma) {
+    TTree *seriesTree = (TTree*)dir->Get("timeSeries");
+    TTree *segmentTree = (TTree*)dir->Get("intervalEntries");
+    TParameter<Double_t> *intervalSeconds = (TParameter<Double_t>*)dir->Get("intervalSeconds");
+    TParameter<Double_t> *sigma = (TParameter<Double_t>*)dir->Get("nSigma");
+    TParameter<Long64_t> *nsTimeFirst = (TParameter<Long64_t>*)dir->Get("nsTimeFirst");
+    TParameter<Long64_t> *nsTimeLast = (TParameter<Long64_t>*)dir->Get("nsTimeLast");
+    if (!seriesTree || !segmentTree || !intervalSeconds || !sigma || !nsTimeFirst || !nsTimeLast) return false;
+    series = TimeSeries();
+    series.intervalSeconds = intervalSeconds->GetVal();
+    series.nsTimeFirst = nsTimeFirst->GetVal();
+    series.nsTimeLast = nsTimeLast->GetVal();
+    nSigma = sigma->GetVal();
+
+    IntervalAccumulator row;
+    Long64_t intervalIndex;
+    seriesTree->SetBranchAddress("interval", &intervalIndex);
+    seriesTree->SetBranchAddress("nEvents", &row.nEvents);
+    seriesTree->SetBranchAddress("triggerCounts", row.triggerCounts);
+    seriesTree->SetBranchAddress("baselineMeanSum", row.baselineMeanSum);
+    seriesTree->SetBranchAddress("baselineMeanSum2", row.baselineMeanSum2);
+    seriesTree->SetBranchAddress("baselineRMSSum", row.baselineRMSSum);
+    seriesTree->SetBranchAddress("baselineRMSSum2", row.baselineRMSSum2);
+    seriesTree->SetBranchAddress("baselineRMSMax", row.baselineRMSMax);
+    seriesTree->SetBranchAddress("entryFirst", &row.entryFirst);
+    seriesTree->SetBranchAddress("entryLast", &row.entryLast);
+    for (Long64_t i = 0; i < seriesTree->GetEntries(); i++) {
+        seriesTree->GetEntry(i);
+        if (i == 0) series.firstInterval = intervalIndex;
+        series.intervals.push_back(row);
+    }
+
+    EntrySegment segment;
+    segmentTree->SetBranchAddress("first", &segment.first);
+    segmentTree->SetBranchAddress("last", &segment.last);
+    segmentTree->SetBranchAddress("interval", &segment.interval);
+    for (Long64_t i = 0; i < segmentTree->GetEntries(); i++) {
+        segmentTree->GetEntry(i);
+        series.segments.push_back(segment);
+    }
+    return true;
+}
+
+#endif
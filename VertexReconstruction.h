@@ -0,0 +1,218 @@
+//VertexReconstructor estimates the position of the light source of an event from the 12 PMT charges (area / mu1 in p.e.).
+//Positions are in units of the PMT pitch (ChannelX/ChannelY of DetectorGeometry.h): x, y in the plane of the PMTs, z the distance
+//from that plane.
+//  - centroid: charge-weighted mean of the PMT positions (x, y only),
+//  - vertex:   maximum of the multinomial likelihood sum_p q_p log f_p(v) of the charge fractions, with f_p proportional to the
+//              solid angle of PMT p seen from v, z / (d^2 + z^2)^(3/2). The likelihood is evaluated on a grid (step 0.1 pitch)
+//              whose log f_p are precomputed: a coarse scan (every third point) for all events of a block, then the fine
+//              points around the best coarse point of each event.
+//  - correctedPE: totalPE x S(center) / S(vertex), S the summed solid angle of the 12 PMTs (light collection of the vertex).
+//The coarse scan is a dense loop over the events of a block for each grid point, so it runs on channel-major blocks
+//(PhysicalBlock of DetectorGeometry.h) and is vectorized by the compiler.
+//The resolution is set by the photon statistics, not by the grid step: on simulated events (vertexBenchmark) the mean absolute
+//error of x / y / z is about 0.19 / 0.18 / 0.25 pitch at 300 p.e. and 0.12 / 0.12 / 0.16 pitch at 1000 p.e.
+//
+//    VertexReconstructor vertexReco;
+//    PhysicalBlock<Double_t> areas;   ... areas.Add(area) for every event ...
+//    VertexBlock vertices;
+//    vertexReco.Reconstruct(areas, mu1, vertices);   // vertices.x[i], .y[i], .z[i], .correctedPE[i] of the i-th added event
+#ifndef VERTEXRECONSTRUCTION_H
+#define VERTEXRECONSTRUCTION_H
+
+#include "DetectorGeometry.h"
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+
+// Results of a block of events
+struct VertexBlock {
+    std::vector<double> centroidX, centroidY, x, y, z, totalPE, correctedPE;
+
+    void Resize(int n) {
+        std::vector<double> *columns[7] = {&centroidX, &centroidY, &x, &y, &z, &totalPE, &correctedPE};
+        for (int c = 0; c < 7; c++) columns[c]->resize(n);
+    }
+};
+
+class VertexReconstructor {
+public:
+    // Grid step and z range in PMT pitches; x, y cover the PMT block plus half a pitch
+    explicit VertexReconstructor(double step = 0.1, double zMin = 0.2, double zMax = 4.0) : fStep(step), fThreads(1) {
+        fX0 = -1.5;
+        fY0 = -2.0;
+        fZ0 = zMin;
+        fNX = (int)std::lround(3.0 / step) + 1;
+        fNY = (int)std::lround(4.0 / step) + 1;
+        fNZ = (int)std::lround((zMax - zMin) / step) + 1;
+        fLogFraction.resize((size_t)fNX * fNY * fNZ * kNumPMTs);
+        fCollection.resize((size_t)fNX * fNY * fNZ);
+        for (int ix = 0; ix < fNX; ix++) {
+            for (int iy = 0; iy < fNY; iy++) {
+                for (int iz = 0; iz < fNZ; iz++) {
+                    size_t g = Index(ix, iy, iz);
+                    double omega[kNumPMTs], sum = 0;
+                    for (int p = 0; p < kNumPMTs; p++) {
+                        omega[p] = SolidAngle(p, fX0 + ix * step, fY0 + iy * step, fZ0 + iz * step);
+                        sum += omega[p];
+                    }
+                    for (int p = 0; p < kNumPMTs; p++) fLogFraction[LogIndex(ix, iy, iz, p)] = (float)log(omega[p] / sum);
+                    fCollection[g] = sum;
+                }
+            }
+        }
+        // Reference for the corrected PE: center of the PMT block at the middle of the z range
+        double zCenter = 0.5 * (zMin + zMax), sum = 0;
+        for (int p = 0; p < kNumPMTs; p++) sum += SolidAngle(p, 0, 0, zCenter);
+        fReferenceCollection = sum;
+        // Coarse grid: every third point, with its log fractions stored contiguously for the scan
+        for (int ix = 0; ix < fNX; ix += 3) {
+            for (int iy = 0; iy < fNY; iy += 3) {
+                for (int iz = 0; iz < fNZ; iz += 3) {
+                    size_t g = Index(ix, iy, iz);
+                    fCoarseIndex.push_back(g);
+                    for (int p = 0; p < kNumPMTs; p++) fCoarseLogFraction.push_back(fLogFraction[LogIndex(ix, iy, iz, p)]);
+                }
+            }
+        }
+    }
+
+    // Threads used for a block (1 by default)
+    void SetThreads(int nThreads) { fThreads = std::max(nThreads, 1); }
+
+    // Reconstruct all events of a block of PMT areas; mu1 are the SPE gains (physical index)
+    template <class T, int BlockSize>
+    void Reconstruct(const PhysicalBlock<T, BlockSize> &areas, const Double_t *mu1, VertexBlock &out) {
+        int n = areas.Size();
+        out.Resize(n);
+        fCharges.resize((size_t)kNumPMTs * n);
+        std::fill(out.totalPE.begin(), out.totalPE.end(), 0.0);
+        std::fill(out.centroidX.begin(), out.centroidX.end(), 0.0);
+        std::fill(out.centroidY.begin(), out.centroidY.end(), 0.0);
+
+        // Charges in p.e. (negative pedestal fluctuations count as 0) and the centroid
+        ForEachChannel<kPMTChannel>([&](int p) {
+            const T *area = areas.Channel(p);
+            double *q = &fCharges[(size_t)p * n];
+            double gain = (mu1[p] > 0) ? 1.0 / mu1[p] : 0.0;
+            double px = ChannelX(p), py = ChannelY(p);
+            for (int i = 0; i < n; i++) {
+                q[i] = std::max(area[i] * gain, 0.0);
+                out.totalPE[i] += q[i];
+                out.centroidX[i] += q[i] * px;
+                out.centroidY[i] += q[i] * py;
+            }
+        });
+        for (int i = 0; i < n; i++) {
+            double norm = (out.totalPE[i] > 0) ? 1.0 / out.totalPE[i] : 0.0;
+            out.centroidX[i] *= norm;
+            out.centroidY[i] *= norm;
+        }
+
+        // Scans: the tiles of events are independent and split over the threads
+        fBestIndex.resize(n);
+        int nTiles = (n + kTile - 1) / kTile;
+        int nWorkers = std::max(1, std::min(fThreads, nTiles / 4));
+        if (nWorkers == 1) {
+            ReconstructTiles(0, nTiles, n, out);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (int w = 0; w < nWorkers; w++) {
+            workers.emplace_back([&, w]() { ReconstructTiles(nTiles * w / nWorkers, nTiles * (w + 1) / nWorkers, n, out); });
+        }
+        for (size_t w = 0; w < workers.size(); w++) workers[w].join();
+    }
+
+private:
+    double fStep, fX0, fY0, fZ0;
+    int fThreads;
+    int fNX, fNY, fNZ;
+    std::vector<float> fLogFraction;   // [ix][iy][PMT][iz] log of the expected charge fraction
+    std::vector<double> fCollection;   // [grid point] summed solid angle of the PMTs
+    double fReferenceCollection;
+    std::vector<size_t> fCoarseIndex;        // Grid point of each coarse point
+    std::vector<float> fCoarseLogFraction;   // [coarse point][PMT]
+    static const int kTile = 32;             // Events scanned together
+    // Work buffers of a block
+    std::vector<double> fCharges;
+    std::vector<size_t> fBestIndex;
+
+    // Coarse and fine scan of the events of tiles [firstTile, lastTile) of a block of n events
+    void ReconstructTiles(int firstTile, int lastTile, int n, VertexBlock &out) {
+        // Coarse scan: every coarse grid point for a tile of events at once; the tile stays in L1 and the loops over its
+        // events vectorize
+        for (int first = firstTile * kTile; first < std::min(lastTile * kTile, n); first += kTile) {
+            float q[kNumPMTs][kTile], best[kTile];
+            int bestCoarse[kTile];
+            for (int p = 0; p < kNumPMTs; p++) {
+                for (int t = 0; t < kTile; t++) q[p][t] = (first + t < n) ? fCharges[(size_t)p * n + first + t] : 0;
+            }
+            for (int t = 0; t < kTile; t++) {
+                best[t] = -HUGE_VALF;
+                bestCoarse[t] = 0;
+            }
+            for (size_t c = 0; c < fCoarseIndex.size(); c++) {
+                const float *logFraction = &fCoarseLogFraction[c * kNumPMTs];
+                float likelihood[kTile] = {0};
+                for (int p = 0; p < kNumPMTs; p++) {
+                    float w = logFraction[p];
+                    for (int t = 0; t < kTile; t++) likelihood[t] += w * q[p][t];
+                }
+                for (int t = 0; t < kTile; t++) {
+                    bool better = likelihood[t] > best[t];
+                    best[t] = better ? likelihood[t] : best[t];
+                    bestCoarse[t] = better ? (int)c : bestCoarse[t];
+                }
+            }
+            for (int t = 0; t < kTile && first + t < n; t++) fBestIndex[first + t] = fCoarseIndex[bestCoarse[t]];
+        }
+
+        // Fine scan around the best coarse point of each event
+        for (int i = firstTile * kTile; i < std::min(lastTile * kTile, n); i++) {
+            if (out.totalPE[i] <= 0) {
+                out.x[i] = out.y[i] = out.z[i] = out.correctedPE[i] = 0;
+                continue;
+            }
+            float q[kNumPMTs];
+            for (int p = 0; p < kNumPMTs; p++) q[p] = fCharges[(size_t)p * n + i];
+            size_t g0 = fBestIndex[i];
+            int ix0 = g0 / (fNY * fNZ), iy0 = (g0 / fNZ) % fNY, iz0 = g0 % fNZ;
+            int izLow = std::max(iz0 - 2, 0), nz = std::min(iz0 + 2, fNZ - 1) - izLow + 1;
+            size_t best = g0;
+            float bestLikelihood = -HUGE_VALF;
+            for (int ix = std::max(ix0 - 2, 0); ix <= std::min(ix0 + 2, fNX - 1); ix++) {
+                for (int iy = std::max(iy0 - 2, 0); iy <= std::min(iy0 + 2, fNY - 1); iy++) {
+                    // The z points of a column are contiguous for each PMT: their likelihoods first, then the maximum
+                    size_t g = Index(ix, iy, izLow);
+                    const float *logFraction = &fLogFraction[LogIndex(ix, iy, izLow, 0)];
+                    float likelihood[5] = {0};
+                    for (int p = 0; p < kNumPMTs; p++) {
+                        for (int k = 0; k < nz; k++) likelihood[k] += logFraction[p * fNZ + k] * q[p];
+                    }
+                    for (int k = 0; k < nz; k++) {
+                        if (likelihood[k] > bestLikelihood) {
+                            bestLikelihood = likelihood[k];
+                            best = g + k;
+                        }
+                    }
+                }
+            }
+            out.x[i] = fX0 + (best / (fNY * fNZ)) * fStep;
+            out.y[i] = fY0 + ((best / fNZ) % fNY) * fStep;
+            out.z[i] = fZ0 + (best % fNZ) * fStep;
+            out.correctedPE[i] = out.totalPE[i] * fReferenceCollection / fCollection[best];
+        }
+    }
+
+    size_t Index(int ix, int iy, int iz) const { return ((size_t)ix * fNY + iy) * fNZ + iz; }
+    size_t LogIndex(int ix, int iy, int iz, int p) const { return (((size_t)ix * fNY + iy) * kNumPMTs + p) * fNZ + iz; }
+
+    // Solid angle of a small PMT at distance z below the point, up to a common factor
+    static double SolidAngle(int p, double x, double y, double z) {
+        double dx = x - ChannelX(p), dy = y - ChannelY(p);
+        return z / pow(dx * dx + dy * dy + z * z, 1.5);
+    }
+};
+
+#endif
@@ -0,0 +1,192 @@
+//WaveformCodec packs the adcVal[23][45] waveforms of an event for skims and waveform caches.
+//The samples sit within a few counts of a baseline of about 170 ADC with rare large pulses, so each channel is stored as
+//    baseline (median of the channel, 16 bits) | width w | number of exceptions | 45 zigzag residuals x - baseline in w bits each
+//followed by the exceptions (sample index, raw 16-bit value) for the samples whose residual does not fit in w bits (pulses).
+//The width is chosen per channel to minimize the size; a quiet channel takes about 4 bits per sample instead of 16.
+//Decoding unpacks with a width known at compile time (one specialization per width), so the loops are unrolled and vectorized.
+//The encoding is little endian.
+//
+//    PackedWaveforms packed;
+//    packed.Branch(skimTree);                     // branches adcPackedBytes and adcPacked[adcPackedBytes]
+//    packed.Pack(adcVal); skimTree->Fill();
+//
+//    WaveformReader reader(tree, adcVal);         // reads adcVal or adcPacked, whichever the tree has
+//    tree->GetEntry(entry); reader.Decode();
+#ifndef WAVEFORMCODEC_H
+#define WAVEFORMCODEC_H
+
+#include <TTree.h>
+#include <algorithm>
+#include <cstring>
+
+const int kCodecChannels = 23;
+const int kCodecSamples = 45;
+// Worst case: every channel at 16 bits with all samples as exceptions, plus the 8 bytes of padding read by the decoder
+const int kMaxPackedWaveformBytes = kCodecChannels * (4 + 2 * kCodecSamples + 3 * kCodecSamples) + 8;
+
+inline UInt_t ZigZag(int value) { return ((UInt_t)value << 1) ^ (UInt_t)(value >> 31); }
+inline int UnZigZag(UInt_t z) { return (int)(z >> 1) ^ -(int)(z & 1); }
+
+// Bytes of the packed residuals of one channel
+inline int PackedBits(int w) { return (kCodecSamples * w + 7) / 8; }
+
+// Encode one channel, returns the number of bytes written
+inline int EncodeChannel(const Short_t *x, UChar_t *out) {
+    Short_t sorted[kCodecSamples];
+    std::copy(x, x + kCodecSamples, sorted);
+    std::nth_element(sorted, sorted + kCodecSamples / 2, sorted + kCodecSamples);
+    Short_t baseline = sorted[kCodecSamples / 2];
+
+    UInt_t z[kCodecSamples];
+    for (int k = 0; k < kCodecSamples; k++) z[k] = ZigZag(x[k] - baseline);
+
+    // Width with the smallest size; residuals >= the escape code (all ones) are stored as exceptions
+    int bestWidth = 16, bestSize = 1 << 30;
+    for (int w = 0; w <= 16; w++) {
+        UInt_t escape = (1u << w) - 1;
+        int nExceptions = 0;
+        for (int k = 0; k < kCodecSamples; k++) nExceptions += (w == 0) ? (z[k] != 0) : (z[k] >= escape);
+        int size = PackedBits(w) + 3 * nExceptions;
+        if (size < bestSize) {
+            bestSize = size;
+            bestWidth = w;
+        }
+    }
+
+    int w = bestWidth;
+    UInt_t escape = (1u << w) - 1;
+    UChar_t *bits = out + 4;
+    memset(bits, 0, PackedBits(w));
+    UChar_t *exceptions = bits + PackedBits(w);
+    int nExceptions = 0;
+    for (int k = 0; k < kCodecSamples; k++) {
+        UInt_t v = z[k];
+        if ((w == 0 && v != 0) || (w > 0 && v >= escape)) {
+            exceptions[3 * nExceptions] = k;
+            exceptions[3 * nExceptions + 1] = (UShort_t)x[k] & 0xff;
+            exceptions[3 * nExceptions + 2] = (UShort_t)x[k] >> 8;
+            nExceptions++;
+            v = escape;
+        }
+        for (int b = 0; b < w; b++) {
+            if (v & (1u << b)) bits[(k * w + b) >> 3] |= 1 << ((k * w + b) & 7);
+        }
+    }
+
+    out[0] = (UShort_t)baseline & 0xff;
+    out[1] = (UShort_t)baseline >> 8;
+    out[2] = w;
+    out[3] = nExceptions;
+    return 4 + PackedBits(w) + 3 * nExceptions;
+}
+
+// Unpack the 45 residuals of width W; reads up to 7 bytes past the packed bits
+template <int W>
+inline void UnpackResiduals(const UChar_t *bits, Short_t baseline, Short_t *x) {
+    const ULong64_t mask = (1ull << W) - 1;
+    for (int k = 0; k < kCodecSamples; k++) {
+        ULong64_t word;
+        memcpy(&word, bits + ((k * W) >> 3), 8);
+        UInt_t z = (word >> ((k * W) & 7)) & mask;
+        x[k] = baseline + UnZigZag(z);
+    }
+}
+
+// Decode one channel from the nBytes bytes at in (including the padding after the last channel), returns the position after it or
+// 0 if the data is corrupt. The header is checked against nBytes before the residuals and exceptions are read.
+inline const UChar_t *DecodeChannel(const UChar_t *in, int nBytes, Short_t *x) {
+    if (nBytes < 4) return 0;
+    Short_t baseline = (Short_t)(in[0] | (in[1] << 8));
+    int w = in[2];
+    int nExceptions = in[3];
+    if (w > 16 || nExceptions > kCodecSamples || 4 + PackedBits(w) + 3 * nExceptions + 8 > nBytes) return 0;
+    const UChar_t *bits = in + 4;
+    switch (w) {
+        case 0: std::fill(x, x + kCodecSamples, baseline); break;
+        case 1: UnpackResiduals<1>(bits, baseline, x); break;
+        case 2: UnpackResiduals<2>(bits, baseline, x); break;
+        case 3: UnpackResiduals<3>(bits, baseline, x); break;
+        case 4: UnpackResiduals<4>(bits, baseline, x); break;
+        case 5: UnpackResiduals<5>(bits, baseline, x); break;
+        case 6: UnpackResiduals<6>(bits, baseline, x); break;
+        case 7: UnpackResiduals<7>(bits, baseline, x); break;
+        case 8: UnpackResiduals<8>(bits, baseline, x); break;
+        case 9: UnpackResiduals<9>(bits, baseline, x); break;
+        case 10: UnpackResiduals<10>(bits, baseline, x); break;
+        case 11: UnpackResiduals<11>(bits, baseline, x); break;
+        case 12: UnpackResiduals<12>(bits, baseline, x); break;
+        case 13: UnpackResiduals<13>(bits, baseline, x); break;
+        case 14: UnpackResiduals<14>(bits, baseline, x); break;
+        case 15: UnpackResiduals<15>(bits, baseline, x); break;
+        case 16: UnpackResiduals<16>(bits, baseline, x); break;
+        default: return 0;
+    }
+    const UChar_t *exceptions = bits + PackedBits(w);
+    for (int e = 0; e < nExceptions; e++) {
+        int k = exceptions[3 * e];
+        if (k >= kCodecSamples) return 0;
+        x[k] = (Short_t)(exceptions[3 * e + 1] | (exceptions[3 * e + 2] << 8));
+    }
+    return exceptions + 3 * nExceptions;
+}
+
+// Encode all channels of an event; out must hold kMaxPackedWaveformBytes. Returns the number of bytes used.
+inline int EncodeWaveforms(const Short_t (&adcVal)[23][45], UChar_t *out) {
+    int nBytes = 0;
+    for (int ch = 0; ch < kCodecChannels; ch++) nBytes += EncodeChannel(adcVal[ch], out + nBytes);
+    memset(out + nBytes, 0, 8); // Padding for the 8-byte loads of the decoder
+    return nBytes + 8;
+}
+
+inline bool DecodeWaveforms(const UChar_t *in, int nBytes, Short_t (&adcVal)[23][45]) {
+    if (nBytes < 0 || nBytes > kMaxPackedWaveformBytes) return false;
+    const UChar_t *pos = in;
+    for (int ch = 0; ch < kCodecChannels; ch++) {
+        pos = DecodeChannel(pos, nBytes - (int)(pos - in), adcVal[ch]);
+        if (!pos) return false;
+    }
+    return true;
+}
+
+// Branch buffers of the packed waveforms of one event
+struct PackedWaveforms {
+    Int_t nBytes = 0;
+    UChar_t bytes[kMaxPackedWaveformBytes];
+
+    void Pack(const Short_t (&adcVal)[23][45]) { nBytes = EncodeWaveforms(adcVal, bytes); }
+    bool Unpack(Short_t (&adcVal)[23][45]) const { return DecodeWaveforms(bytes, nBytes, adcVal); }
+
+    void Branch(TTree *tree) {
+        tree->Branch("adcPackedBytes", &nBytes, "adcPackedBytes/I");
+        tree->Branch("adcPacked", bytes, "adcPacked[adcPackedBytes]/b");
+    }
+    void SetBranchAddress(TTree *tree) {
+        tree->SetBranchAddress("adcPackedBytes", &nBytes);
+        tree->SetBranchAddress("adcPacked", bytes);
+    }
+};
+
+// Reads adcVal from a tree with either raw (adcVal) or packed (adcPacked) waveforms
+class WaveformReader {
+public:
+    WaveformReader(TTree *tree, Short_t (&adcVal)[23][45]) : fAdcVal(adcVal), fPacked(false) {
+        if (!tree->GetBranch("adcVal") && tree->GetBranch("adcPacked")) {
+            fPacked = true;
+            fWaveforms.SetBranchAddress(tree);
+        } else {
+            tree->SetBranchAddress("adcVal", adcVal);
+        }
+    }
+
+    // Call after every GetEntry
+    bool Decode() { return !fPacked || fWaveforms.Unpack(fAdcVal); }
+
+    bool IsPacked() const { return fPacked; }
+
+private:
+    Short_t (&fAdcVal)[23][45];
+    bool fPacked;
+    PackedWaveforms fWaveforms;
+};
+
+#endif
@@ -0,0 +1,207 @@
+//This code classifies every entry of a run file once and stores a compact tag word per entry (bits in EventTags.h):
+//muon from the SiPM veto, LED, PMT trigger, Michel candidate / afterpulse-like (MichelCuts.h) and high baseline RMS.
+//The channels with high baseline RMS are stored as a 23-bit mask. Both go to the friend tree "tagTree" (one entry per input entry),
+//and for every tag a TEntryList "<tag>Entries" is stored so downstream tools can loop only over the entries they care about:
+//    TFile tags("tags_output.root"); tree->SetEntryList((TEntryList*)tags.Get("michelEntries"));
+//With --entries begin:end only those entries are classified (the gains are still calibrated on the whole run, so the tags do not
+//depend on the sharding); mergeShards joins the tagTree of consecutive shards in order and adds up their entry lists.
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TF1.h>
+#include <TEntryList.h>
+#include <vector>
+#include <string>
+#include <cmath>
+#include "EventTags.h"
+#include "RunFileIO.h"
+#include "DetectorGeometry.h"
+#include "MichelCuts.h"
+
+using namespace std;
+
+Double_t SPEfit(Double_t *x, Double_t *par) {
+    Double_t A0 = par[0];
+    Double_t mu0 = par[1];
+    Double_t sigma0 = par[2];
+    Double_t A1 = par[3];
+    Double_t mu1 = par[4];
+    Double_t sigma1 = par[5];
+    Double_t A2 = par[6];
+    Double_t A3 = par[7];
+
+    Double_t term1 = A0 * exp(-0.5 * pow((x[0] - mu0) / sigma0, 2));
+    Double_t term2 = A1 * exp(-0.5 * pow((x[0] - mu1) / sigma1, 2));
+    Double_t term3 = A2 * exp(-0.5 * pow((x[0] - sqrt(2) * mu1) / sqrt(2 * sigma1 * sigma1 - sigma0 * sigma0), 2));
+    Double_t term4 = A3 * exp(-0.5 * pow((x[0] - sqrt(3) * mu1) / sqrt(3 * sigma1 * sigma1 - 2 * sigma0 * sigma0), 2));
+
+    return term1 + term2 + term3 + term4;
+}
+
+void classifyEvents(const char *fileName, const char *outputName, EntryRange range) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree!" << endl;
+        file->Close();
+        return;
+    }
+
+    Short_t adcVal[23][45];
+    Double_t area[23], pulseH[23], baselineRMS[23];
+    Int_t peakPosition[23], triggerBits;
+
+    tree->SetBranchAddress("adcVal", adcVal);
+    tree->SetBranchAddress("area", area);
+    tree->SetBranchAddress("pulseH", pulseH);
+    tree->SetBranchAddress("peakPosition", peakPosition);
+    tree->SetBranchAddress("baselineRMS", baselineRMS);
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+
+    double muonThreshold = 1000;   // SiPM veto threshold in ADC counts (timeDistributionMuonMichel.cpp)
+
+    // 1. CALIBRATION PHASE: SPE gains for the Michel cuts
+    TH1F *histArea[12];
+    for (int i=0; i<12; i++) {
+        histArea[i] = new TH1F(Form("PMT%d_Area",i+1),
+                              Form("PMT %d;ADC Counts;Events",i+1), 150, -50, 400);
+    }
+
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("area", 1);
+    tree->SetBranchStatus("triggerBits", 1);
+    CacheActiveBranches(tree);
+    Long64_t nEntries = tree->GetEntries();
+    PhysicalBlock<Double_t> ledAreas; // LED event areas in physical order, filled one PMT at a time
+    auto fillBlock = [&]() {
+        ForEachChannel<kPMTChannel>([&](int p) {
+            const Double_t *values = ledAreas.Channel(p);
+            for (int i=0; i<ledAreas.Size(); i++) histArea[p]->Fill(values[i]);
+        });
+        ledAreas.Clear();
+    };
+    for (Long64_t entry=0; entry<nEntries; entry++) {
+        tree->GetEntry(entry);
+        if (triggerBits != 16) continue;
+        ledAreas.Add(area);
+        if (ledAreas.Full()) fillBlock();
+    }
+    fillBlock();
+    tree->SetBranchStatus("*", 1);
+    CacheActiveBranches(tree);
+
+    Double_t mu1[12] = {0};
+    for (int i=0; i<12; i++) {
+        if (histArea[i]->GetEntries() == 0) {
+            cerr << "Empty histogram for PMT " << i+1 << endl;
+            continue;
+        }
+        TF1 *fitFunc = new TF1("fitFunc", SPEfit, -50, 400, 8);
+        fitFunc->SetParameters(1000, 0, 10, 1000, 50, 10, 500, 500);
+        histArea[i]->Fit("fitFunc", "RQ0");
+        mu1[i] = fitFunc->GetParameter(4);
+        delete fitFunc;
+    }
+
+    // 2. CLASSIFICATION PASS
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        file->Close();
+        return;
+    }
+
+    UInt_t tags, highRMSChannels;
+    TTree *tagTree = new TTree("tagTree", "Per-entry event tags");
+    tagTree->Branch("tags", &tags, "tags/i");
+    tagTree->Branch("highRMSChannels", &highRMSChannels, "highRMSChannels/i");
+
+    TEntryList *tagEntries[nEventTags];
+    Long64_t tagCounts[nEventTags] = {0};
+    for (int t=0; t<nEventTags; t++) {
+        tagEntries[t] = new TEntryList(Form("%sEntries", eventTagNames[t]), Form("Entries tagged %s", eventTagNames[t]), tree);
+    }
+
+    ClampEntryRange(range, nEntries);
+    tree->SetCacheEntryRange(range.begin, range.end);
+    for (Long64_t entry=range.begin; entry<range.end; entry++) {
+        tree->GetEntry(entry);
+        tags = 0;
+        highRMSChannels = 0;
+
+        if (triggerBits == 16) tags |= kTagLED;
+
+        for (int ch=0; ch<23; ch++) {
+            if (baselineRMS[ch] > kHighRMSThreshold) highRMSChannels |= (1u << ch);
+        }
+        if (highRMSChannels) tags |= kTagHighRMS;
+
+        for (int p=kNumPMTs; p<kNumDetectorChannels && !(tags & kTagMuon); p++) {
+            for (int k=0; k<45; k++) {
+                if (adcVal[HardwareChannel(p)][k] > muonThreshold) {
+                    tags |= kTagMuon;
+                    break;
+                }
+            }
+        }
+
+        if (triggerBits == 2) {
+            tags |= kTagPMTTrigger;
+
+            MichelCutResult cuts = ApplyMichelCuts(pulseH, area, baselineRMS, mu1, PeakPositionRMS(peakPosition));
+            tags |= cuts.good ? kTagMichel : kTagAfterpulseLike;
+        }
+
+        for (int t=0; t<nEventTags; t++) {
+            if (tags & (1u << t)) {
+                tagEntries[t]->Enter(entry);
+                tagCounts[t]++;
+            }
+        }
+        tagTree->Fill();
+    }
+
+    // 3. OUTPUT
+    outputFile->cd();
+    tagTree->Write();
+    cout << "Tagged " << range.end - range.begin << " entries:" << endl;
+    for (int t=0; t<nEventTags; t++) {
+        tagEntries[t]->Write();
+        cout << "  " << eventTagNames[t] << ": " << tagCounts[t] << endl;
+        delete tagEntries[t];
+    }
+    outputFile->Close();
+    delete outputFile;
+
+    for (int i=0; i<12; i++) delete histArea[i];
+    file->Close();
+    cout << "Tags written to " << outputName << " (tree tagTree)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    EntryRange range;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], range)) {
+                cerr << "Error: invalid entry range " << argv[i] << endl;
+                return 1;
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() < 1 || args.size() > 2) {
+        cerr << "Usage: " << argv[0] << " <input_file.root> [tags_output.root] [--entries begin:end]" << endl;
+        return 1;
+    }
+    InitRunFileIO();
+    classifyEvents(args[0], (args.size() == 2) ? args[1] : "tags_output.root", range);
+    return 0;
+}
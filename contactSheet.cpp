@@ -0,0 +1,297 @@
+//This code draws waveform thumbnails of many events tiled on contact sheets, for reviewing flagged events without one TCanvas per event.
+//Each thumbnail shows the 12 PMT traces in the physical layout of onlyPMTsWaveform (or, with --sipm, the 22 PMT and SiPM traces in
+//the layout of waveformsBasedOnPhysicalLocation), on a common ADC scale per event, with the entry number in the top-left corner.
+//The traces are drawn straight into an ARGB pixel buffer by worker threads (one per core); TASImage only writes the PNG.
+//The events are the entries of a classifyEvents tag (--tag michel, from tags_output.root or --tags), of a text file with one entry
+//number per line (--events), or the first --max entries (1000 by default). Sheets are written as <prefix>_NNNN.png together with <prefix>_NNNN.txt
+//listing the entries of the tiles row by row.
+//    ./contactSheet run21672_processed_v5.root --tag michel --sipm --per-sheet 400 --prefix michel_sheet
+#include <iostream>
+#include <fstream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TEntryList.h>
+#include <TASImage.h>
+#include "RunFileIO.h"
+#include "WaveformCodec.h"
+#include "DetectorGeometry.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+const UInt_t kSheetWhite = 0xFFFFFFFF, kGutterColor = 0xFF808080, kCellBorder = 0xFFD8D8D8;
+const UInt_t kPMTTrace = 0xFF000000, kSiPMTrace = 0xFF007000, kLabel = 0xFFC00000;
+
+// 3x5 pixel digits, 3 bits per row from the top
+const int digitFont[10] = {
+    0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF
+};
+
+// Arrangement of the channels in a thumbnail: hardware channel of every cell, -1 for empty cells
+struct ThumbnailLayout {
+    int rows, cols;
+    vector<int> channel;
+};
+
+ThumbnailLayout pmtLayout() {
+    // Same arrangement as onlyPMTsWaveform
+    ThumbnailLayout result = {kPMTDisplayRows, kPMTDisplayCols, vector<int>()};
+    for (int row = 0; row < kPMTDisplayRows; row++) {
+        for (int col = 0; col < kPMTDisplayCols; col++) result.channel.push_back(HardwareChannel(PMTDisplaySlot(row, col)));
+    }
+    return result;
+}
+
+ThumbnailLayout fullLayout() {
+    // Same arrangement as waveformsBasedOnPhysicalLocation
+    ThumbnailLayout result = {kDisplayRows, kDisplayCols, vector<int>()};
+    for (int row = 0; row < kDisplayRows; row++) {
+        for (int col = 0; col < kDisplayCols; col++) {
+            int p = DisplaySlot(row, col);
+            result.channel.push_back(p < 0 ? -1 : HardwareChannel(p));
+        }
+    }
+    return result;
+}
+
+struct EventWaveforms {
+    Long64_t entry;
+    Short_t adcVal[23][45];
+};
+
+// Pixel buffer of one sheet
+struct Sheet {
+    int width, height;
+    vector<UInt_t> pixels;
+
+    void Set(int x, int y, UInt_t color) {
+        if (x >= 0 && x < width && y >= 0 && y < height) pixels[(size_t)y * width + x] = color;
+    }
+
+    void Line(int x0, int y0, int x1, int y1, UInt_t color) {
+        int dx = abs(x1 - x0), dy = -abs(y1 - y0);
+        int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+        for (int err = dx + dy;;) {
+            Set(x0, y0, color);
+            if (x0 == x1 && y0 == y1) break;
+            int e2 = 2 * err;
+            if (e2 >= dy) { err += dy; x0 += sx; }
+            if (e2 <= dx) { err += dx; y0 += sy; }
+        }
+    }
+
+    void Number(int x, int y, Long64_t value, UInt_t color) {
+        string digits = to_string(value);
+        for (size_t d = 0; d < digits.size(); d++) {
+            int glyph = digitFont[digits[d] - '0'];
+            for (int row = 0; row < 5; row++) {
+                for (int col = 0; col < 3; col++) {
+                    if (glyph & (1 << (14 - 3 * row - col))) Set(x + 4 * d + col, y + row, color);
+                }
+            }
+        }
+    }
+};
+
+const int kLabelHeight = 7, kGutterWidth = 2;
+
+// Draw the thumbnail of one event with its top-left corner at (x0, y0)
+void drawThumbnail(Sheet &sheet, const EventWaveforms &event, const ThumbnailLayout &layout, int x0, int y0, int cellW, int cellH) {
+    // Common ADC scale of the event, as the full-size plots use one maximum for all pads
+    int yMin = 1 << 30, yMax = -(1 << 30);
+    for (size_t c = 0; c < layout.channel.size(); c++) {
+        int ch = layout.channel[c];
+        if (ch < 0) continue;
+        for (int k = 0; k < 45; k++) {
+            yMin = min(yMin, (int)event.adcVal[ch][k]);
+            yMax = max(yMax, (int)event.adcVal[ch][k]);
+        }
+    }
+    if (yMax <= yMin) yMax = yMin + 1;
+
+    sheet.Number(x0 + 1, y0 + 1, event.entry, kLabel);
+    for (int row = 0; row < layout.rows; row++) {
+        for (int col = 0; col < layout.cols; col++) {
+            int ch = layout.channel[row * layout.cols + col];
+            if (ch < 0) continue;
+            int cx = x0 + col * cellW, cy = y0 + kLabelHeight + row * cellH;
+            for (int x = 0; x < cellW; x++) {
+                sheet.Set(cx + x, cy, kCellBorder);
+                sheet.Set(cx + x, cy + cellH - 1, kCellBorder);
+            }
+            for (int y = 0; y < cellH; y++) {
+                sheet.Set(cx, cy + y, kCellBorder);
+                sheet.Set(cx + cellW - 1, cy + y, kCellBorder);
+            }
+
+            UInt_t color = (ch < 12) ? kPMTTrace : kSiPMTrace;
+            int px = 0, py = 0;
+            for (int k = 0; k < 45; k++) {
+                int x = cx + 1 + k * (cellW - 3) / 44;
+                int y = cy + cellH - 2 - (int)((double)(event.adcVal[ch][k] - yMin) * (cellH - 3) / (yMax - yMin));
+                if (k > 0) sheet.Line(px, py, x, y, color);
+                px = x;
+                py = y;
+            }
+        }
+    }
+}
+
+// Entries to review: a tag of classifyEvents, a list file, or the first maxEvents entries
+vector<Long64_t> selectEntries(const string &tag, const char *tagsName, const char *eventsName, Long64_t maxEvents, Long64_t nEntries) {
+    vector<Long64_t> entries;
+    if (!tag.empty()) {
+        TFile *tagsFile = TFile::Open(tagsName);
+        if (!tagsFile || tagsFile->IsZombie()) {
+            cerr << "Error opening tags file: " << tagsName << endl;
+            delete tagsFile;
+            return entries;
+        }
+        TEntryList *list = (TEntryList*)tagsFile->Get((tag + "Entries").c_str());
+        if (!list) cerr << "Error: no entry list " << tag << "Entries in " << tagsName << endl;
+        for (Long64_t i = 0; list && i < list->GetN(); i++) entries.push_back(list->GetEntry(i));
+        tagsFile->Close();
+        delete tagsFile;
+    } else if (eventsName) {
+        ifstream events(eventsName);
+        if (!events) cerr << "Error opening events file: " << eventsName << endl;
+        Long64_t entry;
+        while (events >> entry) {
+            if (entry >= 0 && entry < nEntries) entries.push_back(entry);
+        }
+    } else {
+        for (Long64_t entry = 0; entry < min(maxEvents, nEntries); entry++) entries.push_back(entry);
+    }
+    if (maxEvents > 0 && (Long64_t)entries.size() > maxEvents) entries.resize(maxEvents);
+    return entries;
+}
+
+void contactSheet(const char *fileName, const string &tag, const char *tagsName, const char *eventsName, Long64_t maxEvents,
+                  bool withSiPMs, int perSheet, int sheetCols, int cellW, int cellH, const string &prefix) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree 'tree'!" << endl;
+        file->Close();
+        return;
+    }
+
+    // Only the waveforms are read, raw or packed
+    Short_t adcVal[23][45];
+    tree->SetBranchStatus("*", 0);
+    const char *waveformBranches[3] = {"adcVal", "adcPacked", "adcPackedBytes"};
+    for (int b = 0; b < 3; b++) {
+        if (tree->GetBranch(waveformBranches[b])) tree->SetBranchStatus(waveformBranches[b], 1);
+    }
+    WaveformReader waveforms(tree, adcVal);
+    CacheActiveBranches(tree);
+
+    vector<Long64_t> entries = selectEntries(tag, tagsName, eventsName, maxEvents, tree->GetEntries());
+    if (entries.empty()) {
+        cerr << "No events to draw" << endl;
+        file->Close();
+        return;
+    }
+
+    ThumbnailLayout layout = withSiPMs ? fullLayout() : pmtLayout();
+    int tileW = layout.cols * cellW + kGutterWidth, tileH = kLabelHeight + layout.rows * cellH + kGutterWidth;
+    int nWorkers = max(1u, thread::hardware_concurrency());
+    int nSheets = (entries.size() + perSheet - 1) / perSheet;
+    cout << "Drawing " << entries.size() << " events on " << nSheets << " sheets with " << nWorkers << " threads..." << endl;
+
+    vector<EventWaveforms> events(perSheet);
+    for (int s = 0; s < nSheets; s++) {
+        // Read the events of the sheet (entries in increasing order keep the cache reads sequential)
+        size_t first = (size_t)s * perSheet, nEvents = min((size_t)perSheet, entries.size() - first);
+        for (size_t i = 0; i < nEvents; i++) {
+            events[i].entry = entries[first + i];
+            tree->GetEntry(events[i].entry);
+            if (!waveforms.Decode()) cerr << "Warning: corrupt packed waveforms in event " << events[i].entry << endl;
+            memcpy(events[i].adcVal, adcVal, sizeof(adcVal));
+        }
+
+        // Draw the tiles in parallel; every tile has its own pixels, so the workers never write the same pixel
+        int cols = min((size_t)sheetCols, nEvents);
+        int rows = (nEvents + cols - 1) / cols;
+        Sheet sheet;
+        sheet.width = cols * tileW + kGutterWidth;
+        sheet.height = rows * tileH + kGutterWidth;
+        sheet.pixels.assign((size_t)sheet.width * sheet.height, kGutterColor);
+        for (size_t i = 0; i < nEvents; i++) {
+            int x0 = kGutterWidth + (i % cols) * tileW, y0 = kGutterWidth + (i / cols) * tileH;
+            for (int y = 0; y < tileH - kGutterWidth; y++) {
+                fill(sheet.pixels.begin() + (size_t)(y0 + y) * sheet.width + x0,
+                     sheet.pixels.begin() + (size_t)(y0 + y) * sheet.width + x0 + tileW - kGutterWidth, kSheetWhite);
+            }
+        }
+        atomic<size_t> next(0);
+        vector<thread> workers;
+        for (int w = 0; w < nWorkers; w++) {
+            workers.emplace_back([&]() {
+                for (size_t i = next++; i < nEvents; i = next++) {
+                    drawThumbnail(sheet, events[i], layout, kGutterWidth + (i % cols) * tileW, kGutterWidth + (i / cols) * tileH,
+                                  cellW, cellH);
+                }
+            });
+        }
+        for (auto &worker : workers) worker.join();
+
+        // Write the sheet and its tile index
+        string sheetName = prefix + Form("_%04d", s);
+        TASImage image(sheet.width, sheet.height);
+        copy(sheet.pixels.begin(), sheet.pixels.end(), image.GetArgbArray());
+        image.WriteImage((sheetName + ".png").c_str(), TImage::kPng);
+        ofstream index((sheetName + ".txt").c_str());
+        for (size_t i = 0; i < nEvents; i++) index << events[i].entry << ((i + 1) % cols == 0 || i + 1 == nEvents ? "\n" : " ");
+        cout << "Sheet " << sheetName << ".png: " << nEvents << " events" << endl;
+    }
+
+    file->Close();
+}
+
+int main(int argc, char* argv[]) {
+    string tag, prefix = "contact_sheet";
+    const char *tagsName = "tags_output.root", *eventsName = 0;
+    Long64_t maxEvents = 0;
+    bool withSiPMs = false;
+    int perSheet = 400, sheetCols = 20, cellW = 0, cellH = 0;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--tag" && i + 1 < argc) tag = argv[++i];
+        else if (arg == "--tags" && i + 1 < argc) tagsName = argv[++i];
+        else if (arg == "--events" && i + 1 < argc) eventsName = argv[++i];
+        else if (arg == "--max" && i + 1 < argc) maxEvents = atoll(argv[++i]);
+        else if (arg == "--sipm") withSiPMs = true;
+        else if (arg == "--per-sheet" && i + 1 < argc) perSheet = atoi(argv[++i]);
+        else if (arg == "--columns" && i + 1 < argc) sheetCols = atoi(argv[++i]);
+        else if (arg == "--cell" && i + 1 < argc) sscanf(argv[++i], "%dx%d", &cellW, &cellH);
+        else if (arg == "--prefix" && i + 1 < argc) prefix = argv[++i];
+        else args.push_back(argv[i]);
+    }
+    if (tag.empty() && !eventsName && maxEvents <= 0) maxEvents = 1000;
+    if (cellW <= 0 || cellH <= 0) {
+        cellW = withSiPMs ? 32 : 48;
+        cellH = withSiPMs ? 24 : 32;
+    }
+    if (args.size() != 1 || perSheet < 1 || sheetCols < 1 || cellW < 8 || cellH < 8) {
+        cerr << "Usage: " << argv[0] << " <root_file> [--tag name [--tags tags_output.root] | --events list.txt] [--max N] [--sipm]"
+             << " [--per-sheet N] [--columns N] [--cell WxH] [--prefix name]" << endl;
+        return 1;
+    }
+
+    InitRunFileIO();
+    contactSheet(args[0], tag, tagsName, eventsName, maxEvents, withSiPMs, perSheet, sheetCols, cellW, cellH, prefix);
+    return 0;
+}
@@ -0,0 +1,178 @@
+//This code computes the derived columns of DerivedColumns.h (peakPositionRMS, totalPE, maxADC, maxSiPMADC) for every entry of a run
+//file and writes them to the friend tree "derived" (one entry per input entry), so later jobs read them instead of recomputing:
+//    tree->AddFriend("derived", "derived_columns.root");
+//    tree->Draw("derived.totalPE", "triggerBits==2");
+//The SPE gains for totalPE are read from the fitResults tree written by SinglePEfitGaussian (params[4] = mu1).
+//With the gains the position of every event is reconstructed as well (VertexReconstruction.h): centroidX, centroidY,
+//vertexX, vertexY, vertexZ (PMT pitches) and the position-corrected correctedPE. The entries are processed in blocks: the PMT
+//areas of a block are transposed once and all its vertices are reconstructed together (--threads N splits a block).
+//Without a results file totalPE and the position columns are not written.
+//With --entries begin:end only those entries are processed; the derived trees of consecutive shards are joined in order by mergeShards.
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include "RunFileIO.h"
+#include "DerivedColumns.h"
+#include "VertexReconstruction.h"
+
+using namespace std;
+
+// Read mu1 of the 12 PMTs from the SinglePEfitGaussian results
+bool readGains(const char *resultsName, Double_t mu1[12]) {
+    TFile *results = TFile::Open(resultsName);
+    if (!results || results->IsZombie()) {
+        cerr << "Error opening results file: " << resultsName << endl;
+        delete results;
+        return false;
+    }
+    TTree *fitTree = (TTree*)results->Get("fitResults");
+    if (!fitTree) {
+        cerr << "Error: 'fitResults' not found in " << resultsName << endl;
+        results->Close();
+        return false;
+    }
+    Int_t pmtNumber;
+    Double_t params[8];
+    fitTree->SetBranchAddress("pmt", &pmtNumber);
+    fitTree->SetBranchAddress("params", params);
+    int nFound = 0;
+    for (Long64_t i = 0; i < fitTree->GetEntries(); i++) {
+        fitTree->GetEntry(i);
+        if (pmtNumber < 1 || pmtNumber > 12) continue;
+        mu1[pmtNumber - 1] = params[4];
+        nFound++;
+    }
+    results->Close();
+    delete results;
+    return nFound == 12;
+}
+
+const int kBlockSize = 4096; // Entries per block; the same as the memoization block of DerivedColumns
+
+void deriveColumns(const char *fileName, const char *resultsName, const char *outputName, EntryRange range, int nThreads) {
+    Double_t mu1[12] = {0};
+    bool haveGains = resultsName && readGains(resultsName, mu1);
+
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree!" << endl;
+        file->Close();
+        return;
+    }
+
+    Short_t adcVal[23][45];
+    Double_t area[23];
+    Int_t peakPosition[23];
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("adcVal", 1);
+    tree->SetBranchStatus("area", 1);
+    tree->SetBranchStatus("peakPosition", 1);
+    tree->SetBranchAddress("adcVal", adcVal);
+    tree->SetBranchAddress("area", area);
+    tree->SetBranchAddress("peakPosition", peakPosition);
+    CacheActiveBranches(tree);
+
+    DerivedColumns columns(kBlockSize);
+    DefineRunColumns(columns, adcVal, area, peakPosition, mu1);
+    vector<string> persisted = {"peakPositionRMS", "maxADC", "maxSiPMADC"};
+    size_t nPerEntry = persisted.size(); // Columns computed entry by entry; the position columns are computed per block
+    if (haveGains) persisted.push_back("totalPE");
+
+    // Position columns read the results of the current block
+    VertexReconstructor vertexReco;
+    vertexReco.SetThreads(nThreads);
+    PhysicalBlock<Double_t, kBlockSize> areas;
+    VertexBlock vertices;
+    int entryInBlock = 0;
+    if (haveGains) {
+        const vector<double> *results[6] = {&vertices.centroidX, &vertices.centroidY, &vertices.x, &vertices.y, &vertices.z,
+                                            &vertices.correctedPE};
+        const char *names[6] = {"centroidX", "centroidY", "vertexX", "vertexY", "vertexZ", "correctedPE"};
+        for (int c = 0; c < 6; c++) {
+            const vector<double> *result = results[c];
+            columns.Define(names[c], [result, &entryInBlock]() { return (*result)[entryInBlock]; });
+            persisted.push_back(names[c]);
+        }
+    }
+
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        file->Close();
+        return;
+    }
+    TTree *derivedTree = columns.MakeFriendTree("derived", persisted);
+
+    ClampEntryRange(range, tree->GetEntries());
+    tree->SetCacheEntryRange(range.begin, range.end);
+    // Blocks on the memoization blocks of DerivedColumns (multiples of kBlockSize), so the first one of a range may be shorter
+    for (Long64_t blockStart = range.begin, blockEnd; blockStart < range.end; blockStart = blockEnd) {
+        blockEnd = min((blockStart / kBlockSize + 1) * kBlockSize, range.end);
+        // Read the block: the per-entry columns are memoized, the PMT areas collected in physical order
+        areas.Clear();
+        for (Long64_t entry = blockStart; entry < blockEnd; entry++) {
+            tree->GetEntry(entry);
+            columns.SetEntry(entry);
+            for (size_t c = 0; c < nPerEntry; c++) columns.Get(persisted[c].c_str());
+            if (haveGains) {
+                columns.Get("totalPE");
+                areas.Add(area);
+            }
+        }
+        if (haveGains) vertexReco.Reconstruct(areas, mu1, vertices);
+        // Fill the friend tree from the memoized values and the block results
+        for (Long64_t entry = blockStart; entry < blockEnd; entry++) {
+            columns.SetEntry(entry);
+            entryInBlock = entry - blockStart;
+            columns.FillFriendTree(derivedTree);
+        }
+    }
+
+    outputFile->cd();
+    derivedTree->Write();
+    outputFile->Close();
+    delete outputFile;
+    file->Close();
+
+    cout << "Derived columns of " << range.end - range.begin << " entries written to " << outputName << " (tree derived):";
+    for (size_t i = 0; i < persisted.size(); i++) cout << " " << persisted[i];
+    cout << endl;
+}
+
+int main(int argc, char* argv[]) {
+    int nThreads = 1;
+    EntryRange range;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], range)) {
+                cerr << "Error: invalid entry range " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--threads" && i + 1 < argc) {
+            nThreads = atoi(argv[++i]);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() < 1 || args.size() > 3) {
+        cerr << "Usage: " << argv[0] << " <input_file.root> [spe_results.root] [derived_columns.root] [--threads N]"
+             << " [--entries begin:end]" << endl;
+        return 1;
+    }
+    InitRunFileIO();
+    deriveColumns(args[0], (args.size() >= 2) ? args[1] : 0, (args.size() == 3) ? args[2] : "derived_columns.root", range,
+                  nThreads);
+    return 0;
+}
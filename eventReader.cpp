@@ -0,0 +1,186 @@
+//This code is a reader library with a C interface for Python (eventreader.py) and other non-ROOT clients. It reads a subset of
+//the columns of the run tree page by page: a page is a range of up to pageEntries entries, and every column of the page is one
+//contiguous buffer (entries x elements, e.g. 1000 x 23 x 45 Short_t for adcVal) owned by the library. Python wraps the buffers as
+//NumPy arrays through the buffer protocol without copying, so paging through a multi-GB run needs only the memory of one page.
+//Only the branches of the selected columns are read (and cached, see RunFileIO.h).
+//    g++ -O2 -shared -fPIC eventReader.cpp -o libeventReader.so $(root-config --cflags --libs)
+//
+//    void *reader = er_open("run21672_processed_v5.root", "tree", "eventID,pulseH,nsTime", 10000);
+//    for (long long begin = 0; begin < er_entries(reader); begin += er_read(reader, begin)) {
+//        const double *pulseH = (const double*)er_column_data(reader, 1);   // [n][23], valid until the next er_read
+//    }
+//    er_close(reader);
+//
+//Only fixed-size columns (scalars and arrays such as adcVal[23][45]) are supported. Functions returning a pointer or a count
+//return 0 / -1 on failure and er_last_error() says why.
+#include <TFile.h>
+#include <TTree.h>
+#include <TLeaf.h>
+#include "RunFileIO.h"
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+struct ReaderColumn {
+    string name;
+    string dtype;          // NumPy type string, e.g. "<f8"
+    vector<int> dims;      // Shape of one entry, empty for scalars
+    size_t entryBytes;
+    vector<char> staging;  // Branch buffer of the current entry
+    vector<char> page;     // entries x entryBytes of the current page
+};
+
+struct EventReader {
+    TFile *file;
+    TTree *tree;
+    Long64_t pageEntries;
+    vector<ReaderColumn> columns;
+};
+
+static thread_local string lastError;
+
+// NumPy type string of a ROOT leaf type, "" if unsupported
+static string numpyType(const string &typeName) {
+    if (typeName == "Double_t") return "<f8";
+    if (typeName == "Float_t") return "<f4";
+    if (typeName == "Long64_t") return "<i8";
+    if (typeName == "ULong64_t") return "<u8";
+    if (typeName == "Int_t") return "<i4";
+    if (typeName == "UInt_t") return "<u4";
+    if (typeName == "Short_t") return "<i2";
+    if (typeName == "UShort_t") return "<u2";
+    if (typeName == "Char_t") return "|i1";
+    if (typeName == "UChar_t") return "|u1";
+    if (typeName == "Bool_t") return "|b1";
+    return "";
+}
+
+// Dimensions of a leaf from its title, e.g. "adcVal[23][45]" -> {23, 45}
+static vector<int> leafDims(const char *title) {
+    vector<int> dims;
+    for (const char *p = strchr(title, '['); p; p = strchr(p + 1, '[')) dims.push_back(atoi(p + 1));
+    return dims;
+}
+
+static bool addColumn(EventReader *reader, const string &name) {
+    TLeaf *leaf = reader->tree->GetLeaf(name.c_str());
+    if (!leaf) {
+        lastError = "no column " + name;
+        return false;
+    }
+    ReaderColumn column;
+    column.name = name;
+    column.dtype = numpyType(leaf->GetTypeName());
+    if (column.dtype.empty() || leaf->GetLeafCount()) {
+        lastError = "column " + name + " is not a fixed-size array of a basic type";
+        return false;
+    }
+    column.dims = leafDims(leaf->GetTitle());
+    column.entryBytes = (size_t)leaf->GetLenStatic() * leaf->GetLenType();
+    column.staging.resize(column.entryBytes);
+    column.page.resize(column.entryBytes * reader->pageEntries);
+    reader->columns.push_back(column);
+    return true;
+}
+
+extern "C" {
+
+const char *er_last_error() { return lastError.c_str(); }
+
+// Open the tree of a run file with the comma-separated columns; pages hold up to pageEntries entries
+void *er_open(const char *path, const char *treeName, const char *columns, long long pageEntries) {
+    InitRunFileIO();
+    if (pageEntries < 1) {
+        lastError = "pageEntries must be positive";
+        return 0;
+    }
+    TFile *file = TFile::Open(path);
+    if (!file || file->IsZombie()) {
+        lastError = string("cannot open ") + path;
+        delete file;
+        return 0;
+    }
+    TTree *tree = (TTree*)file->Get(treeName);
+    if (!tree) {
+        lastError = string("no tree ") + treeName + " in " + path;
+        file->Close();
+        delete file;
+        return 0;
+    }
+
+    EventReader *reader = new EventReader;
+    reader->file = file;
+    reader->tree = tree;
+    reader->pageEntries = pageEntries;
+
+    istringstream names(columns);
+    string name;
+    while (getline(names, name, ',')) {
+        if (name.empty()) continue;
+        if (!addColumn(reader, name)) {
+            file->Close();
+            delete file;
+            delete reader;
+            return 0;
+        }
+    }
+
+    // The vectors of the columns do not move any more, the branch addresses stay valid
+    tree->SetBranchStatus("*", 0);
+    for (size_t c = 0; c < reader->columns.size(); c++) {
+        tree->SetBranchStatus(reader->columns[c].name.c_str(), 1);
+        tree->SetBranchAddress(reader->columns[c].name.c_str(), reader->columns[c].staging.data());
+    }
+    CacheActiveBranches(tree);
+    return reader;
+}
+
+void er_close(void *handle) {
+    EventReader *reader = (EventReader*)handle;
+    if (!reader) return;
+    reader->file->Close();
+    delete reader->file;
+    delete reader;
+}
+
+long long er_entries(void *handle) { return ((EventReader*)handle)->tree->GetEntries(); }
+
+int er_ncolumns(void *handle) { return ((EventReader*)handle)->columns.size(); }
+
+const char *er_column_name(void *handle, int c) { return ((EventReader*)handle)->columns[c].name.c_str(); }
+
+const char *er_column_dtype(void *handle, int c) { return ((EventReader*)handle)->columns[c].dtype.c_str(); }
+
+// Shape of one entry of column c written to dims (up to maxDims values); returns the number of dimensions (0 for scalars)
+int er_column_dims(void *handle, int c, int *dims, int maxDims) {
+    const vector<int> &columnDims = ((EventReader*)handle)->columns[c].dims;
+    for (int d = 0; d < (int)columnDims.size() && d < maxDims; d++) dims[d] = columnDims[d];
+    return columnDims.size();
+}
+
+// Read the page starting at entry begin; returns the number of entries in the page (0 past the end, -1 on a read error).
+// The buffers of the previous page are overwritten.
+long long er_read(void *handle, long long begin) {
+    EventReader *reader = (EventReader*)handle;
+    Long64_t end = min(begin + reader->pageEntries, reader->tree->GetEntries());
+    for (Long64_t entry = begin; entry < end; entry++) {
+        if (reader->tree->GetEntry(entry) <= 0) {
+            lastError = "read error at entry " + to_string(entry);
+            return -1;
+        }
+        for (size_t c = 0; c < reader->columns.size(); c++) {
+            ReaderColumn &column = reader->columns[c];
+            memcpy(column.page.data() + (entry - begin) * column.entryBytes, column.staging.data(), column.entryBytes);
+        }
+    }
+    return max(end - begin, (Long64_t)0);
+}
+
+// Buffer of column c in the current page: entries x entry shape, contiguous
+void *er_column_data(void *handle, int c) { return ((EventReader*)handle)->columns[c].page.data(); }
+
+}
@@ -0,0 +1,109 @@
+import ctypes
+import os
+import numpy as np
+
+# Paged reading of run trees through libeventReader.so (eventReader.cpp).
+# The arrays of a page are NumPy views of the library's buffers (no copy); they are overwritten by the next page,
+# so copy them (np.copy) if they must outlive it. Every view holds the reader handle through its base, so the buffers are
+# freed only when the reader is closed and no view is left: a view kept after close() still shows its last page.
+#
+#   with RunReader("run21672_processed_v5.root", ["eventID", "pulseH", "nsTime"]) as reader:
+#       for begin, page in reader.pages():
+#           print(begin, page["pulseH"].shape)    # (n, 23)
+
+_lib = None
+
+
+def _library():
+    global _lib
+    if _lib is None:
+        path = os.environ.get("EVENTREADER_LIB",
+                              os.path.join(os.path.dirname(os.path.abspath(__file__)), "libeventReader.so"))
+        _lib = ctypes.CDLL(path)
+        _lib.er_open.restype = ctypes.c_void_p
+        _lib.er_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_longlong]
+        _lib.er_close.argtypes = [ctypes.c_void_p]
+        _lib.er_entries.restype = ctypes.c_longlong
+        _lib.er_entries.argtypes = [ctypes.c_void_p]
+        _lib.er_ncolumns.argtypes = [ctypes.c_void_p]
+        _lib.er_column_name.restype = ctypes.c_char_p
+        _lib.er_column_name.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        _lib.er_column_dtype.restype = ctypes.c_char_p
+        _lib.er_column_dtype.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        _lib.er_column_dims.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.c_int]
+        _lib.er_read.restype = ctypes.c_longlong
+        _lib.er_read.argtypes = [ctypes.c_void_p, ctypes.c_longlong]
+        _lib.er_column_data.restype = ctypes.c_void_p
+        _lib.er_column_data.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        _lib.er_last_error.restype = ctypes.c_char_p
+    return _lib
+
+
+class _Handle:
+    # Reader of the library, closed when the RunReader and all the views of its buffers are gone
+    def __init__(self, value):
+        self.value = value
+
+    def __del__(self):
+        if self.value and _lib is not None:
+            _lib.er_close(self.value)
+            self.value = None
+
+
+class RunReader:
+    def __init__(self, file_path, columns, page_entries=10000, tree="tree"):
+        lib = _library()
+        handle = lib.er_open(file_path.encode(), tree.encode(), ",".join(columns).encode(), page_entries)
+        if not handle:
+            raise IOError(lib.er_last_error().decode())
+        self._handle = _Handle(handle)
+        self.entries = lib.er_entries(handle)
+        self._columns = []
+        for c in range(lib.er_ncolumns(handle)):
+            dims = (ctypes.c_int * 8)()
+            ndims = lib.er_column_dims(handle, c, dims, 8)
+            self._columns.append((lib.er_column_name(handle, c).decode(),
+                                  np.dtype(lib.er_column_dtype(handle, c).decode()),
+                                  tuple(dims[:ndims])))
+
+    def __len__(self):
+        return self.entries
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        # The library reader is closed now, or with the last view of its buffers
+        self._handle = None
+
+    def read(self, begin):
+        # Page starting at entry begin: dict of column name -> array of shape (n,) + entry shape
+        lib = _library()
+        if not self._handle:
+            raise ValueError("read from a closed RunReader")
+        n = lib.er_read(self._handle.value, begin)
+        if n < 0:
+            raise IOError(lib.er_last_error().decode())
+        page = {}
+        for c, (name, dtype, dims) in enumerate(self._columns):
+            count = n * int(np.prod(dims, dtype=np.int64))
+            buffer = (ctypes.c_char * (count * dtype.itemsize)).from_address(lib.er_column_data(self._handle.value, c))
+            buffer._handle = self._handle  # The view's base keeps the reader open
+            page[name] = np.frombuffer(buffer, dtype=dtype, count=count).reshape((n,) + dims)
+        return page
+
+    def pages(self, begin=0, end=None):
+        # Pages from begin to end (exclusive); each page replaces the previous one
+        end = self.entries if end is None else min(end, self.entries)
+        while begin < end:
+            page = self.read(begin)
+            n = len(next(iter(page.values()))) if page else 0
+            if n == 0:
+                break
+            if begin + n > end:
+                page = {name: values[:end - begin] for name, values in page.items()}
+            yield begin, page
+            begin += n
@@ -0,0 +1,92 @@
+//This code measures the fill throughput of FastHist against TH1F on the binning of timeDiffHist (100 bins, 0 - 10000 ns) with
+//exponential values (2.2 us, 5% of them past the range), and checks that both give the same bin contents:
+//  - TH1F::Fill, one thread,
+//  - FastHist::Fill and FillN, one thread,
+//  - FastHist::Fill with one shard per thread and FastHist::AtomicFill, nThreads threads.
+//Usage: fastHistBenchmark [nFills] [nThreads]
+#include <iostream>
+#include <TH1F.h>
+#include <TRandom3.h>
+#include "FastHist.h"
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+
+// Wall time of f in seconds
+template <class F>
+double timeIt(F f) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Fill values with nThreads threads, thread t taking every nThreads-th block of values
+template <class F>
+void fillThreaded(const vector<double> &values, int nThreads, F fill) {
+    vector<thread> workers;
+    size_t chunk = (values.size() + nThreads - 1) / nThreads;
+    for (int t = 0; t < nThreads; t++) {
+        workers.emplace_back([&, t]() {
+            size_t end = min(values.size(), (t + 1) * chunk);
+            for (size_t i = t * chunk; i < end; i++) fill(values[i], t);
+        });
+    }
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+}
+
+bool sameContents(const TH1F *reference, const TH1F *hist) {
+    for (int bin = 0; bin <= reference->GetNbinsX() + 1; bin++) {
+        if (reference->GetBinContent(bin) != hist->GetBinContent(bin)) {
+            cerr << "Error: bin " << bin << " differs: " << reference->GetBinContent(bin) << " vs " << hist->GetBinContent(bin) << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Long64_t nFills = (argc > 1) ? atoll(argv[1]) : 100000000;
+    int nThreads = (argc > 2) ? atoi(argv[2]) : thread::hardware_concurrency();
+    if (nFills <= 0 || nThreads < 1) {
+        cerr << "Usage: " << argv[0] << " [nFills] [nThreads]" << endl;
+        return 1;
+    }
+
+    TRandom3 random(1);
+    vector<double> values(nFills);
+    for (Long64_t i = 0; i < nFills; i++) values[i] = random.Exp(2200);
+
+    TH1F *reference = new TH1F("reference", "TH1F", 100, 0, 10000);
+    reference->SetDirectory(0);
+    double th1Time = timeIt([&]() { for (Long64_t i = 0; i < nFills; i++) reference->Fill(values[i]); });
+
+    FastHist single("single", "FastHist", 100, 0, 10000);
+    double fillTime = timeIt([&]() { for (Long64_t i = 0; i < nFills; i++) single.Fill(values[i]); });
+    FastHist block("block", "FastHist", 100, 0, 10000);
+    double fillNTime = timeIt([&]() { block.FillN(values.data(), nFills); });
+    FastHist sharded("sharded", "FastHist", 100, 0, 10000, nThreads);
+    double shardedTime = timeIt([&]() { fillThreaded(values, nThreads, [&](double x, int t) { sharded.Fill(x, t); }); });
+    FastHist atomic("atomic", "FastHist", 100, 0, 10000);
+    double atomicTime = timeIt([&]() { fillThreaded(values, nThreads, [&](double x, int) { atomic.AtomicFill(x); }); });
+
+    FastHist *filled[4] = {&single, &block, &sharded, &atomic};
+    bool ok = true;
+    for (int h = 0; h < 4; h++) {
+        TH1F *hist = filled[h]->ToTH1F();
+        hist->SetDirectory(0);
+        ok = sameContents(reference, hist) && ok;
+        delete hist;
+    }
+
+    const char *names[5] = {"TH1F::Fill", "FastHist::Fill", "FastHist::FillN", "FastHist::Fill, sharded", "FastHist::AtomicFill"};
+    double times[5] = {th1Time, fillTime, fillNTime, shardedTime, atomicTime};
+    int threads[5] = {1, 1, 1, nThreads, nThreads};
+    for (int m = 0; m < 5; m++) {
+        printf("%-26s %2d thread(s): %8.1f M fills/s, %5.1fx TH1F::Fill\n", names[m], threads[m], nFills / times[m] / 1e6, th1Time / times[m]);
+    }
+    delete reference;
+    return ok ? 0 : 1;
+}
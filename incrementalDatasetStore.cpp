@@ -0,0 +1,392 @@
+//This code keeps a persistent store of per-run partial results so that adding a run to the dataset only costs that run's processing.
+//For every run it stores the LED (triggerBits==16) area histograms and SPE fit mu1 of each PMT, the Michel cut-flow counts,
+//the Michel spectrum and the muon/Michel time differences in <store_dir>/<run>.<path hash>.partial.root. The time differences are
+//paired as in analyzeMuonDecay (MuonMichelPairing.h), so the merged timeDiffHist is the sum of that tool's histograms of the runs.
+//Runs are keyed by file path + size + modification time in <store_dir>/index.txt, so unchanged runs are never reprocessed.
+//PMTs whose SPE fit failed (mu1 <= 0) are left out of the Michel p.e. sum of their run, with a warning.
+//The partials of all runs given on the command line are then merged into dataset_merged.root.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TH1D.h>
+#include <TF1.h>
+#include <TCanvas.h>
+#include <TVectorD.h>
+#include <TSystem.h>
+#include <TStyle.h>
+#include "RunFileIO.h"
+#include "MuonMichelPairing.h"
+#include "MichelCuts.h"
+#include "DetectorGeometry.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <cmath>
+#include <sys/stat.h> // For stat
+
+using namespace std;
+
+// Bins of the Michel cut-flow histogram
+const int nCutFlowBins = 6;
+const char *cutFlowLabels[nCutFlowBins] = {"All", "LED", "PMT trigger", "allAbove2PE", "ConditionB", "Good Michel"};
+
+Double_t SPEfit(Double_t *x, Double_t *par) {
+    Double_t A0 = par[0];
+    Double_t mu0 = par[1];
+    Double_t sigma0 = par[2];
+    Double_t A1 = par[3];
+    Double_t mu1 = par[4];
+    Double_t sigma1 = par[5];
+    Double_t A2 = par[6];
+    Double_t A3 = par[7];
+
+    Double_t term1 = A0 * exp(-0.5 * pow((x[0] - mu0) / sigma0, 2));
+    Double_t term2 = A1 * exp(-0.5 * pow((x[0] - mu1) / sigma1, 2));
+    Double_t term3 = A2 * exp(-0.5 * pow((x[0] - sqrt(2) * mu1) / sqrt(2 * sigma1 * sigma1 - sigma0 * sigma0), 2));
+    Double_t term4 = A3 * exp(-0.5 * pow((x[0] - sqrt(3) * mu1) / sqrt(3 * sigma1 * sigma1 - 2 * sigma0 * sigma0), 2));
+
+    return term1 + term2 + term3 + term4;
+}
+
+// Build the store key of a run file from its path, size and modification time.
+// Returns an empty string if the file cannot be stat'ed.
+string makeRunKey(const char *fileName) {
+    struct stat st;
+    if (stat(fileName, &st) != 0) return "";
+    ostringstream key;
+    key << fileName << " " << (Long64_t)st.st_size << " " << (Long64_t)st.st_mtime;
+    return key.str();
+}
+
+// Name of the partial-result file of a run inside the store; the hash of the path keeps runs of the same name in different
+// directories apart
+TString partialFileName(const char *storeDir, const char *fileName) {
+    TString base = gSystem->BaseName(fileName);
+    return Form("%s/%s.%08x.partial.root", storeDir, base.Data(), TString(fileName).Hash());
+}
+
+// Read the store index: one "<path> <size> <mtime>" key per line; the path may contain spaces
+map<string, string> readIndex(const char *storeDir) {
+    map<string, string> index;
+    ifstream in(Form("%s/index.txt", storeDir));
+    string line;
+    while (getline(in, line)) {
+        size_t mtimePos = line.rfind(' ');
+        size_t sizePos = (mtimePos == string::npos || mtimePos == 0) ? string::npos : line.rfind(' ', mtimePos - 1);
+        if (sizePos == string::npos || sizePos == 0) continue;
+        index[line.substr(0, sizePos)] = line;
+    }
+    return index;
+}
+
+void writeIndex(const char *storeDir, const map<string, string> &index) {
+    TString indexName = Form("%s/index.txt", storeDir);
+    TString tmpName = indexName + ".tmp";
+    ofstream out(tmpName.Data());
+    for (const auto &entry : index) out << entry.second << endl;
+    out.close();
+    // Replace the index atomically so an interrupted job never leaves it half written
+    rename(tmpName.Data(), indexName.Data());
+}
+
+// Process one run file and write its partial results. Returns false on failure.
+bool processRun(const char *fileName, const char *partialName) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return false;
+    }
+
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree!" << endl;
+        file->Close();
+        return false;
+    }
+
+    Short_t adcVal[23][45];
+    Double_t area[23], pulseH[23], baselineRMS[23];
+    Int_t peakPosition[23], triggerBits;
+    Long64_t nsTime;
+
+    tree->SetBranchAddress("adcVal", adcVal);
+    tree->SetBranchAddress("area", area);
+    tree->SetBranchAddress("pulseH", pulseH);
+    tree->SetBranchAddress("peakPosition", peakPosition);
+    tree->SetBranchAddress("baselineRMS", baselineRMS);
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+    tree->SetBranchAddress("nsTime", &nsTime);
+
+    TH1D *cutFlow = new TH1D("CutFlow", "Michel Cut Flow;;Events", nCutFlowBins, 0, nCutFlowBins);
+    for (int i=0; i<nCutFlowBins; i++) cutFlow->GetXaxis()->SetBinLabel(i+1, cutFlowLabels[i]);
+
+    // 1. CALIBRATION PHASE
+    TH1F *histArea[12];
+    for (int i=0; i<12; i++) {
+        histArea[i] = new TH1F(Form("PMT%d_Area",i+1),
+                              Form("PMT %d;ADC Counts;Events",i+1), 150, -50, 400);
+    }
+
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("area", 1);
+    tree->SetBranchStatus("triggerBits", 1);
+    CacheActiveBranches(tree);
+    Long64_t nEntries = tree->GetEntries();
+    PhysicalBlock<Double_t> ledAreas; // LED event areas in physical order, filled one PMT at a time
+    auto fillBlock = [&]() {
+        ForEachChannel<kPMTChannel>([&](int p) {
+            const Double_t *values = ledAreas.Channel(p);
+            for (int i=0; i<ledAreas.Size(); i++) histArea[p]->Fill(values[i]);
+        });
+        ledAreas.Clear();
+    };
+    for (Long64_t entry=0; entry<nEntries; entry++) {
+        tree->GetEntry(entry);
+        cutFlow->Fill(0);
+        if (triggerBits != 16) continue;
+        cutFlow->Fill(1);
+        ledAreas.Add(area);
+        if (ledAreas.Full()) fillBlock();
+    }
+    fillBlock();
+    tree->SetBranchStatus("*", 1);
+    CacheActiveBranches(tree);
+
+    TVectorD mu1(12);
+    for (int i=0; i<12; i++) {
+        if (histArea[i]->GetEntries() == 0) {
+            cerr << "Empty histogram for PMT " << i+1 << endl;
+            continue;
+        }
+
+        TF1 *fitFunc = new TF1("fitFunc", SPEfit, -50, 400, 8);
+        fitFunc->SetParameters(1000, 0, 10, 1000, 50, 10, 500, 500);
+        histArea[i]->Fit("fitFunc", "RQ0");
+        mu1[i] = fitFunc->GetParameter(4);
+        delete fitFunc;
+    }
+    for (int i=0; i<12; i++) {
+        if (!(mu1[i] > 0)) cerr << "Warning: PMT " << i+1 << " has no SPE calibration (mu1 = " << mu1[i] << "), left out of the Michel p.e. sum" << endl;
+    }
+
+    // 2. MICHEL SELECTION AND MUON/MICHEL PAIRING (single time-ordered pass)
+    TH1F *michelSpectrum = new TH1F("MichelSpectrum",
+                                   "Michel Electron Spectrum;Photoelectrons (p.e.);Events",
+                                   100, 0, 1000);
+    TH1F *timeDiffHist = new TH1F("timeDiffHist", "Time Difference (Michel - Muon); Time Difference [ns]; Counts", 100, 0, 10000);
+
+    TFile *partialFile = new TFile(partialName, "RECREATE");
+    if (!partialFile || partialFile->IsZombie()) {
+        cerr << "Error creating partial file: " << partialName << endl;
+        file->Close();
+        return false;
+    }
+    Double_t timeDifference;
+    TTree *deltaTTree = new TTree("deltaT", "Muon/Michel time differences");
+    deltaTTree->Branch("timeDifference", &timeDifference, "timeDifference/D");
+
+    MuonMichelPairing pairing;
+    vector<double> timeDifferences;
+    for (Long64_t entry=0; entry<nEntries; entry++) {
+        tree->GetEntry(entry);
+
+        timeDifferences.clear();
+        pairing.AddEvent(nsTime, adcVal, timeDifferences);
+        for (size_t i=0; i<timeDifferences.size(); i++) {
+            timeDifference = timeDifferences[i];
+            timeDiffHist->Fill(timeDifference);
+            deltaTTree->Fill();
+        }
+
+        if (triggerBits != 2) continue;
+        cutFlow->Fill(2);
+
+        MichelCutResult cuts = ApplyMichelCuts(pulseH, area, baselineRMS, mu1.GetMatrixArray(), PeakPositionRMS(peakPosition));
+        if (cuts.allAbove2PE) cutFlow->Fill(3);
+        if (cuts.conditionB) cutFlow->Fill(4);
+        if (!cuts.good) continue;
+        cutFlow->Fill(5);
+
+        Double_t totalPE = 0.0;
+        for (int pmt=0; pmt<12; pmt++) {
+            if (mu1[pmt] > 0) totalPE += area[HardwareChannel(pmt)] / mu1[pmt];
+        }
+        michelSpectrum->Fill(totalPE);
+    }
+
+    // 3. WRITE PARTIAL RESULTS
+    partialFile->cd();
+    for (int i=0; i<12; i++) histArea[i]->Write();
+    mu1.Write("mu1");
+    cutFlow->Write();
+    michelSpectrum->Write();
+    timeDiffHist->Write();
+    deltaTTree->Write();
+    partialFile->Close();
+    delete partialFile;
+
+    cout << fileName << ": " << nEntries << " entries, "
+         << cutFlow->GetBinContent(nCutFlowBins) << " good Michel events stored in " << partialName << endl;
+
+    for (int i=0; i<12; i++) delete histArea[i];
+    delete cutFlow;
+    delete michelSpectrum;
+    delete timeDiffHist;
+    file->Close();
+    return true;
+}
+
+// Merge the partial results of the given runs into dataset-level outputs
+void mergePartials(const vector<TString> &partialNames, const char *outputName) {
+    TH1F *histArea[12] = {0};
+    TH1D *cutFlow = 0;
+    TH1F *michelSpectrum = 0;
+    TH1F *timeDiffHist = 0;
+
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        return;
+    }
+
+    // Per-run calibration table and concatenated Δt list
+    Char_t runName[256];
+    Double_t runMu1[12];
+    Double_t timeDifference;
+    TTree *calibTree = new TTree("calibration", "Per-run SPE calibration");
+    calibTree->Branch("run", runName, "run/C");
+    calibTree->Branch("mu1", runMu1, "mu1[12]/D");
+    TTree *deltaTTree = new TTree("deltaT", "Muon/Michel time differences");
+    deltaTTree->Branch("timeDifference", &timeDifference, "timeDifference/D");
+
+    for (size_t r=0; r<partialNames.size(); r++) {
+        TFile *partialFile = TFile::Open(partialNames[r]);
+        if (!partialFile || partialFile->IsZombie()) {
+            cerr << "Error opening partial file: " << partialNames[r] << endl;
+            continue;
+        }
+
+        for (int i=0; i<12; i++) {
+            TH1F *h = (TH1F*)partialFile->Get(Form("PMT%d_Area", i+1));
+            if (!h) continue;
+            if (!histArea[i]) {
+                histArea[i] = (TH1F*)h->Clone();
+                histArea[i]->SetDirectory(0);
+            } else {
+                histArea[i]->Add(h);
+            }
+        }
+
+        TH1D *runCutFlow = (TH1D*)partialFile->Get("CutFlow");
+        TH1F *runMichel = (TH1F*)partialFile->Get("MichelSpectrum");
+        TH1F *runTimeDiff = (TH1F*)partialFile->Get("timeDiffHist");
+        if (runCutFlow) {
+            if (!cutFlow) { cutFlow = (TH1D*)runCutFlow->Clone(); cutFlow->SetDirectory(0); }
+            else cutFlow->Add(runCutFlow);
+        }
+        if (runMichel) {
+            if (!michelSpectrum) { michelSpectrum = (TH1F*)runMichel->Clone(); michelSpectrum->SetDirectory(0); }
+            else michelSpectrum->Add(runMichel);
+        }
+        if (runTimeDiff) {
+            if (!timeDiffHist) { timeDiffHist = (TH1F*)runTimeDiff->Clone(); timeDiffHist->SetDirectory(0); }
+            else timeDiffHist->Add(runTimeDiff);
+        }
+
+        TVectorD *mu1 = (TVectorD*)partialFile->Get("mu1");
+        snprintf(runName, sizeof(runName), "%s", gSystem->BaseName(partialNames[r]));
+        for (int i=0; i<12; i++) runMu1[i] = mu1 ? (*mu1)[i] : 0;
+        calibTree->Fill();
+
+        TTree *runDeltaT = (TTree*)partialFile->Get("deltaT");
+        if (runDeltaT) {
+            Double_t dt;
+            runDeltaT->SetBranchAddress("timeDifference", &dt);
+            for (Long64_t i=0; i<runDeltaT->GetEntries(); i++) {
+                runDeltaT->GetEntry(i);
+                timeDifference = dt;
+                deltaTTree->Fill();
+            }
+        }
+        partialFile->Close();
+        delete partialFile;
+    }
+
+    outputFile->cd();
+    for (int i=0; i<12; i++) if (histArea[i]) histArea[i]->Write();
+    if (cutFlow) cutFlow->Write();
+    if (michelSpectrum) michelSpectrum->Write();
+    if (timeDiffHist) timeDiffHist->Write();
+    calibTree->Write();
+    deltaTTree->Write();
+
+    if (michelSpectrum) {
+        TCanvas *c1 = new TCanvas("c1", "Michel Electron Spectrum", 1000, 800);
+        c1->SetGrid();
+        michelSpectrum->SetLineColor(kBlue);
+        michelSpectrum->SetLineWidth(2);
+        michelSpectrum->Draw("HIST L");
+        gStyle->SetOptStat(1111);
+        c1->SaveAs("MichelSpectrum_dataset.png");
+        delete c1;
+    }
+
+    if (cutFlow) {
+        cout << "Dataset cut flow:" << endl;
+        for (int i=0; i<nCutFlowBins; i++) {
+            cout << "  " << cutFlowLabels[i] << ": " << cutFlow->GetBinContent(i+1) << endl;
+        }
+    }
+
+    outputFile->Close();
+    delete outputFile;
+    for (int i=0; i<12; i++) delete histArea[i];
+    delete cutFlow;
+    delete michelSpectrum;
+    delete timeDiffHist;
+    cout << "Merged " << partialNames.size() << " runs into " << outputName << endl;
+}
+
+void updateStore(const char *storeDir, const vector<const char*> &runFiles) {
+    gSystem->mkdir(storeDir, kTRUE);
+    map<string, string> index = readIndex(storeDir);
+
+    vector<TString> partialNames;
+    int nProcessed = 0;
+    for (size_t r=0; r<runFiles.size(); r++) {
+        string key = makeRunKey(runFiles[r]);
+        if (key.empty()) {
+            cerr << "Error: cannot stat run file " << runFiles[r] << endl;
+            continue;
+        }
+
+        TString partialName = partialFileName(storeDir, runFiles[r]);
+        bool upToDate = index.count(runFiles[r]) && index[runFiles[r]] == key
+                        && !gSystem->AccessPathName(partialName);
+        if (!upToDate) {
+            if (!processRun(runFiles[r], partialName)) continue;
+            index[runFiles[r]] = key;
+            writeIndex(storeDir, index); // Record each run as soon as it is done
+            nProcessed++;
+        }
+        partialNames.push_back(partialName);
+    }
+    cout << nProcessed << " new or changed runs processed, "
+         << partialNames.size() - nProcessed << " taken from the store." << endl;
+
+    mergePartials(partialNames, "dataset_merged.root");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <store_dir> <run1.root> [run2.root ...]" << endl;
+        return 1;
+    }
+    vector<const char*> runFiles(argv + 2, argv + argc);
+    InitRunFileIO();
+    updateStore(argv[1], runFiles);
+    return 0;
+}
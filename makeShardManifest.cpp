@@ -0,0 +1,139 @@
+//This code splits run files into shards of about the same number of entries and writes a job manifest: one shell command per shard,
+//made from a command template with the placeholders {file}, {begin}, {end}, {shard} and {out}. For example
+//    ./makeShardManifest --shards 64 "./timeDistributionMuonMichel {file} --entries {begin}:{end} --output {out}" run*.root > shards.txt
+//The manifest runs as local processes with
+//    grep -v '^#' shards.txt | xargs -P 8 -I CMD sh -c CMD
+//or as a batch job array where task N runs command N. The last line of the manifest is a comment with the mergeShards command
+//that combines the shard outputs {out} = <prefix>_NNNN.root in manifest order.
+//The entry counts are taken from the run catalog (runCatalog) when --catalog is given, otherwise each file is opened.
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <cstdlib>
+
+using namespace std;
+
+struct Shard {
+    string file;
+    Long64_t begin, end;
+};
+
+// Entry counts of the runs from the catalog written by runCatalog
+map<string, Long64_t> readCatalog(const char *catalogName) {
+    map<string, Long64_t> entries;
+    TFile *catalogFile = TFile::Open(catalogName);
+    if (!catalogFile || catalogFile->IsZombie()) {
+        cerr << "Error opening catalog file: " << catalogName << endl;
+        delete catalogFile;
+        return entries;
+    }
+    TTree *catalog = (TTree*)catalogFile->Get("catalog");
+    if (catalog) {
+        Char_t path[1024];
+        Long64_t nEntries;
+        catalog->SetBranchAddress("path", path);
+        catalog->SetBranchAddress("entries", &nEntries);
+        for (Long64_t i = 0; i < catalog->GetEntries(); i++) {
+            catalog->GetEntry(i);
+            entries[path] = nEntries;
+        }
+    }
+    catalogFile->Close();
+    delete catalogFile;
+    return entries;
+}
+
+Long64_t countEntries(const string &fileName) {
+    TFile *file = TFile::Open(fileName.c_str());
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        delete file;
+        return -1;
+    }
+    TTree *tree = (TTree*)file->Get("tree");
+    Long64_t nEntries = tree ? tree->GetEntries() : -1;
+    file->Close();
+    delete file;
+    return nEntries;
+}
+
+void replaceAll(string &text, const string &from, const string &to) {
+    for (size_t pos = text.find(from); pos != string::npos; pos = text.find(from, pos + to.size())) {
+        text.replace(pos, from.size(), to);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int nShards = 0;
+    Long64_t shardEntries = 0;
+    string prefix = "shard";
+    const char *catalogName = 0;
+    string command;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--shards" && i + 1 < argc) nShards = atoi(argv[++i]);
+        else if (arg == "--entries-per-shard" && i + 1 < argc) shardEntries = atoll(argv[++i]);
+        else if (arg == "--prefix" && i + 1 < argc) prefix = argv[++i];
+        else if (arg == "--catalog" && i + 1 < argc) catalogName = argv[++i];
+        else if (command.empty()) command = arg;
+        else files.push_back(arg);
+    }
+
+    if (command.empty() || files.empty() || (nShards < 1 && shardEntries < 1)) {
+        cerr << "Usage: " << argv[0] << " (--shards N | --entries-per-shard N) [--prefix name] [--catalog run_catalog.root]"
+             << " \"<command template>\" <run.root...>" << endl;
+        return 1;
+    }
+
+    // Entries of every file
+    map<string, Long64_t> catalogEntries;
+    if (catalogName) catalogEntries = readCatalog(catalogName);
+    vector<Long64_t> fileEntries;
+    Long64_t totalEntries = 0;
+    for (size_t f = 0; f < files.size(); f++) {
+        map<string, Long64_t>::iterator it = catalogEntries.find(files[f]);
+        Long64_t n = (it != catalogEntries.end()) ? it->second : countEntries(files[f]);
+        if (n < 0) return 1;
+        fileEntries.push_back(n);
+        totalEntries += n;
+    }
+
+    // Shards never span two files; a file gets a number of shards proportional to its entries, split as evenly as possible
+    if (shardEntries < 1) shardEntries = (totalEntries + nShards - 1) / nShards;
+    if (shardEntries < 1) shardEntries = 1;
+    vector<Shard> shards;
+    for (size_t f = 0; f < files.size(); f++) {
+        Long64_t n = fileEntries[f];
+        Long64_t parts = (n + shardEntries - 1) / shardEntries;
+        if (parts < 1) continue;
+        for (Long64_t p = 0; p < parts; p++) {
+            Shard shard;
+            shard.file = files[f];
+            shard.begin = n * p / parts;
+            shard.end = n * (p + 1) / parts;
+            shards.push_back(shard);
+        }
+    }
+
+    cout << "# " << shards.size() << " shards of about " << shardEntries << " entries, " << totalEntries << " entries in "
+         << files.size() << " files" << endl;
+    string merge = "./mergeShards " + prefix + "_merged.root";
+    for (size_t s = 0; s < shards.size(); s++) {
+        string out = prefix + "_" + Form("%04d", (int)s) + ".root";
+        string line = command;
+        replaceAll(line, "{file}", shards[s].file);
+        replaceAll(line, "{begin}", Form("%lld", shards[s].begin));
+        replaceAll(line, "{end}", Form("%lld", shards[s].end));
+        replaceAll(line, "{shard}", Form("%d", (int)s));
+        replaceAll(line, "{out}", out);
+        cout << line << endl;
+        merge += " " + out;
+    }
+    cout << "# merge: " << merge << endl;
+    return 0;
+}
@@ -0,0 +1,199 @@
+//This code merges the output files of the shards of a job (see makeShardManifest) into one file.
+//The shards are merged in the order given on the command line (the order of the manifest), so the result does not depend on
+//which shard finished first:
+//  - histograms are added, entry lists (TEntryList) are added,
+//  - trees (deltaT time differences, tagTree, recoTree...) are joined shard after shard, so per-entry friend trees of
+//    consecutive shards line up with the input tree again,
+//  - the occupancyCalibration tree is recomputed from the summed counters of the shards (OccupancyAccumulator.h),
+//  - the time series of timeSeriesMonitor are merged interval by interval and flagged again against the whole run, and their
+//    goodEntries are rebuilt from the merged flags (TimeSeriesAccumulator.h),
+//  - everything else (results metadata, layouts, windows) is copied from the first shard.
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1.h>
+#include <TKey.h>
+#include <TList.h>
+#include <TEntryList.h>
+#include <vector>
+#include <set>
+#include <string>
+#include "OccupancyAccumulator.h"
+#include "TimeSeriesAccumulator.h"
+
+using namespace std;
+
+// Sum the occupancy counters of all shards and write the calibration computed from them
+void mergeOccupancyCalibration(const vector<TFile*> &shards, TFile *outputFile) {
+    OccupancyAccumulator acc[12];
+    for (size_t s = 0; s < shards.size(); s++) {
+        TTree *calibTree = (TTree*)shards[s]->Get("occupancyCalibration");
+        Int_t pmtNumber;
+        Long64_t nEvents, nPedestal;
+        Double_t sumArea, sumPedestal;
+        calibTree->SetBranchAddress("pmt", &pmtNumber);
+        calibTree->SetBranchAddress("nEvents", &nEvents);
+        calibTree->SetBranchAddress("nPedestal", &nPedestal);
+        calibTree->SetBranchAddress("sumArea", &sumArea);
+        calibTree->SetBranchAddress("sumPedestal", &sumPedestal);
+        for (Long64_t i = 0; i < calibTree->GetEntries(); i++) {
+            calibTree->GetEntry(i);
+            if (pmtNumber < 1 || pmtNumber > 12) continue;
+            OccupancyAccumulator shardAcc;
+            shardAcc.nEvents = nEvents;
+            shardAcc.nPedestal = nPedestal;
+            shardAcc.sumArea = sumArea;
+            shardAcc.sumPedestal = sumPedestal;
+            acc[pmtNumber - 1].Merge(shardAcc);
+        }
+    }
+
+    outputFile->cd();
+    Int_t pmtNumber;
+    Long64_t nEvents, nPedestal;
+    Double_t sumArea, sumPedestal, lambda, lambdaErr, gain, gainErr, spefitMu1 = -1; // Shard fits are not merged
+    TTree *calibTree = new TTree("occupancyCalibration", "Occupancy gain calibration");
+    calibTree->Branch("pmt", &pmtNumber, "pmt/I");
+    calibTree->Branch("nEvents", &nEvents, "nEvents/L");
+    calibTree->Branch("nPedestal", &nPedestal, "nPedestal/L");
+    calibTree->Branch("sumArea", &sumArea, "sumArea/D");
+    calibTree->Branch("sumPedestal", &sumPedestal, "sumPedestal/D");
+    calibTree->Branch("lambda", &lambda, "lambda/D");
+    calibTree->Branch("lambdaErr", &lambdaErr, "lambdaErr/D");
+    calibTree->Branch("mu1", &gain, "mu1/D");
+    calibTree->Branch("mu1Err", &gainErr, "mu1Err/D");
+    calibTree->Branch("spefitMu1", &spefitMu1, "spefitMu1/D");
+    for (int i = 0; i < 12; i++) {
+        pmtNumber = i + 1;
+        nEvents = acc[i].nEvents;
+        nPedestal = acc[i].nPedestal;
+        sumArea = acc[i].sumArea;
+        sumPedestal = acc[i].sumPedestal;
+        lambda = acc[i].Lambda();
+        lambdaErr = acc[i].LambdaError();
+        gain = acc[i].Gain();
+        gainErr = acc[i].GainError();
+        calibTree->Fill();
+        cout << "PMT " << i + 1 << ": mu1 = " << gain << " +/- " << gainErr << " from " << nEvents << " LED events" << endl;
+    }
+    calibTree->Write();
+}
+
+// Merge the time series of all shards interval by interval, flag the merged intervals against the whole run and write them
+bool mergeTimeSeries(const vector<TFile*> &shards, const vector<const char*> &shardNames, TFile *outputFile) {
+    TimeSeries merged;
+    double nSigma = 0;
+    for (size_t s = 0; s < shards.size(); s++) {
+        TimeSeries shardSeries;
+        if (!ReadTimeSeries(shards[s], shardSeries, nSigma)) {
+            cerr << "Error: incomplete time series in " << shardNames[s] << endl;
+            return false;
+        }
+        if (s > 0 && shardSeries.intervalSeconds != merged.intervalSeconds) {
+            cerr << "Error: " << shardNames[s] << " has intervals of " << shardSeries.intervalSeconds << " s, " << shardNames[0]
+                 << " of " << merged.intervalSeconds << " s" << endl;
+            return false;
+        }
+        if (s == 0) merged.intervalSeconds = shardSeries.intervalSeconds;
+        merged.Merge(shardSeries);
+    }
+
+    vector<UInt_t> flags, badChannels;
+    FlagIntervals(merged, nSigma, flags, badChannels);
+    TEntryList *first = (TEntryList*)shards[0]->Get("goodEntries");
+    if (!first) {
+        cerr << "Error: goodEntries missing in " << shardNames[0] << endl;
+        return false;
+    }
+    outputFile->cd();
+    TEntryList *goodEntries = new TEntryList("goodEntries", "Entries of the unflagged intervals", first->GetTreeName(), first->GetFileName());
+    Long64_t nGood = WriteTimeSeries(merged, flags, badChannels, nSigma, goodEntries);
+    cout << "timeSeries: " << merged.intervals.size() << " intervals, " << nGood << " good entries" << endl;
+    return true;
+}
+
+void mergeShards(const char *outputName, const vector<const char*> &shardNames) {
+    vector<TFile*> shards;
+    for (size_t s = 0; s < shardNames.size(); s++) {
+        TFile *shard = TFile::Open(shardNames[s]);
+        if (!shard || shard->IsZombie()) {
+            cerr << "Error opening shard file: " << shardNames[s] << endl;
+            return;
+        }
+        shards.push_back(shard);
+    }
+
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        return;
+    }
+
+    // The objects of the first shard define what is merged; AutoSaved trees have several cycles, take each name once
+    bool timeSeries = shards[0]->Get("timeSeries") != 0;
+    set<string> timeSeriesObjects(kTimeSeriesObjects, kTimeSeriesObjects + sizeof(kTimeSeriesObjects) / sizeof(kTimeSeriesObjects[0]));
+    set<string> done;
+    TIter nextKey(shards[0]->GetListOfKeys());
+    while (TKey *key = (TKey*)nextKey()) {
+        string name = key->GetName();
+        if (!done.insert(name).second) continue;
+
+        TObject *first = shards[0]->Get(name.c_str());
+        vector<TObject*> parts;
+        for (size_t s = 0; s < shards.size(); s++) {
+            TObject *part = shards[s]->Get(name.c_str());
+            if (!part) {
+                cerr << "Error: " << name << " missing in " << shardNames[s] << ", shards do not match" << endl;
+                outputFile->Close();
+                return;
+            }
+            parts.push_back(part);
+        }
+
+        outputFile->cd();
+        if (timeSeries && timeSeriesObjects.count(name)) {
+            // Written together by mergeTimeSeries
+            if (name == "timeSeries" && !mergeTimeSeries(shards, shardNames, outputFile)) {
+                outputFile->Close();
+                return;
+            }
+        } else if (name == "occupancyCalibration") {
+            mergeOccupancyCalibration(shards, outputFile);
+        } else if (first->InheritsFrom("TTree")) {
+            TTree *merged = ((TTree*)first)->CloneTree(0);
+            for (size_t s = 0; s < parts.size(); s++) merged->CopyEntries((TTree*)parts[s]);
+            merged->Write();
+            cout << name << ": " << merged->GetEntries() << " entries" << endl;
+            delete merged;
+        } else if (first->InheritsFrom("TH1")) {
+            TH1 *merged = (TH1*)first->Clone();
+            for (size_t s = 1; s < parts.size(); s++) merged->Add((TH1*)parts[s]);
+            merged->Write();
+        } else if (first->InheritsFrom("TEntryList")) {
+            TEntryList *merged = (TEntryList*)first->Clone();
+            for (size_t s = 1; s < parts.size(); s++) merged->Add((TEntryList*)parts[s]);
+            merged->Write();
+            cout << name << ": " << merged->GetN() << " entries" << endl;
+        } else {
+            first->Write(name.c_str());
+        }
+    }
+
+    outputFile->Close();
+    delete outputFile;
+    for (size_t s = 0; s < shards.size(); s++) {
+        shards[s]->Close();
+        delete shards[s];
+    }
+    cout << shards.size() << " shards merged into " << outputName << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <merged.root> <shard.root> [shard.root ...]" << endl;
+        return 1;
+    }
+    vector<const char*> shardNames(argv + 2, argv + argc);
+    mergeShards(argv[1], shardNames);
+    return 0;
+}
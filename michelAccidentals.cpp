@@ -0,0 +1,235 @@
+//This code estimates the accidental muon - PMT pulse coincidences in a muon/Michel time difference spectrum and subtracts them.
+//The subtracted spectrum is NOT the timeDiffHist of analyzeMuonDecay (timeDistributionMuonMichel.cpp): it is a different observable,
+//with its own muon definition and pairing, chosen so that the accidentals can be subtracted:
+//  - muons are the events with a veto SiPM above the muon threshold (as in classifyEvents), while analyzeMuonDecay takes every event
+//    as a muon candidate,
+//  - every other event (a PMT pulse, optionally of one trigger type) is paired with ALL muons of a window, while analyzeMuonDecay
+//    pairs each muon only with the first PMT pulse after it (MuonMichelPairing.h). First-match pairing is not linear in the
+//    accidentals, so an off-time estimate could not be subtracted from it.
+//One time-ordered pass over the run: the muon times are kept in a ring buffer spanning the last offset + windows x window ns, and
+//each pulse is paired with the muons
+//  - on time:  muon 0 to window ns before the pulse (signal + accidentals),
+//  - off time: muon in each of the windows shifted by offset, offset + window, ... (accidentals only; their sum is divided by the
+//              number of windows),
+//  - mixed:    muon in one window shifted by a random amount in the off-time range (accidentals averaged over rate changes).
+//Muon and pulse times are the event nsTime plus the time of the largest sample, as in timeDistributionMuonMichel. The accidentals
+//add linearly, so
+//    dtSubtracted = dtOnTime - dtOffTime    (and dtSubtractedMixed = dtOnTime - dtMixed)
+//is the Michel spectrum of the veto-tagged muons. The windows are found by binary search in the buffer, so the pass costs a constant
+//factor over the on-time pairing alone. For comparison the same pass also fills timeDiffHist with the pairing of analyzeMuonDecay
+//(not background subtracted). The histograms (binned like timeDiffHist) go to michel_accidentals.root and michel_accidentals.png.
+//With --entries begin:end only the pulses of those entries are paired. Reading starts one buffer span before the range, so the
+//muons before it are in the buffer as in a pass over the whole run; the histograms of the shards add up in mergeShards.
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TCanvas.h>
+#include <TLegend.h>
+#include <TParameter.h>
+#include <TRandom3.h>
+#include "RunFileIO.h"
+#include "WaveformCodec.h"
+#include "DetectorGeometry.h"
+#include "MuonMichelPairing.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+// Time of the largest sample of a channel group, relative to the event time
+template <ChannelKind Kind>
+double peakTime(const Short_t (&adcVal)[23][45], double &peakADC) {
+    double time = -1;
+    peakADC = -1;
+    ForEachChannel<Kind>([&](int p) {
+        const Short_t *samples = adcVal[HardwareChannel(p)];
+        for (int k = 0; k < 45; k++) {
+            if (samples[k] > peakADC) {
+                peakADC = samples[k];
+                time = (k + 1) * 16.0;
+            }
+        }
+    });
+    return time;
+}
+
+// Fill hist with pulseTime - muonTime - shift for the buffered muons in [pulseTime - shift - window, pulseTime - shift)
+void fillWindow(TH1F *hist, const deque<double> &muonTimes, double pulseTime, double shift, double window) {
+    deque<double>::const_iterator first = lower_bound(muonTimes.begin(), muonTimes.end(), pulseTime - shift - window);
+    deque<double>::const_iterator last = lower_bound(first, muonTimes.end(), pulseTime - shift);
+    for (deque<double>::const_iterator m = first; m != last; ++m) hist->Fill(pulseTime - *m - shift);
+}
+
+void michelAccidentals(const char *fileName, const char *outputName, EntryRange range, double window, double offset, int nWindows,
+                       int trigger, UInt_t seed) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree 'tree'!" << endl;
+        file->Close();
+        return;
+    }
+
+    Short_t adcVal[23][45];
+    Long64_t nsTime;
+    Int_t triggerBits;
+    tree->SetBranchStatus("*", 0);
+    const char *branches[5] = {"adcVal", "adcPacked", "adcPackedBytes", "nsTime", "triggerBits"};
+    for (int b = 0; b < 5; b++) {
+        if (tree->GetBranch(branches[b])) tree->SetBranchStatus(branches[b], 1);
+    }
+    WaveformReader waveforms(tree, adcVal);
+    tree->SetBranchAddress("nsTime", &nsTime);
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+    CacheActiveBranches(tree);
+
+    double muonThreshold = 1000; // SiPM veto threshold in ADC counts (classifyEvents)
+
+    const char *axes = ";Time Difference [ns];Counts";
+    TH1F *dtOnTime = new TH1F("dtOnTime", TString("On-time (Michel - Muon)") + axes, 100, 0, window);
+    TH1F *dtOffTime = new TH1F("dtOffTime", TString("Off-time accidentals, per window") + axes, 100, 0, window);
+    TH1F *dtMixed = new TH1F("dtMixed", TString("Mixed-event accidentals") + axes, 100, 0, window);
+    TH1F *timeDiffHist = new TH1F("timeDiffHist", TString("Time Difference (Michel - Muon), analyzeMuonDecay pairing") + axes,
+                                  100, 0, window);
+    TH1F *hists[4] = {dtOnTime, dtOffTime, dtMixed, timeDiffHist};
+    for (int h = 0; h < 4; h++) {
+        hists[h]->SetDirectory(0);
+        hists[h]->Sumw2();
+    }
+
+    // Ring buffer of the muon times (ns, increasing) still inside the farthest off-time window
+    deque<double> muonTimes;
+    double bufferSpan = offset + nWindows * window;
+    TRandom3 random(seed);
+    MuonMichelPairing pairing(window);
+    vector<double> timeDifferences;
+
+    // The entries of the lead-in only fill the muon buffer and the pairing
+    Long64_t nEntries = tree->GetEntries(), nMuons = 0, nPulses = 0;
+    ClampEntryRange(range, nEntries);
+    Long64_t firstEntry = LeadInEntry(tree, nsTime, range, max(bufferSpan, window) + 45 * 16.0);
+    tree->SetCacheEntryRange(firstEntry, range.end);
+    for (Long64_t entry = firstEntry; entry < range.end; entry++) {
+        tree->GetEntry(entry);
+        if (!waveforms.Decode()) continue;
+        bool inRange = entry >= range.begin;
+
+        timeDifferences.clear();
+        pairing.AddEvent(nsTime, adcVal, timeDifferences);
+        if (inRange) {
+            for (size_t i = 0; i < timeDifferences.size(); i++) timeDiffHist->Fill(timeDifferences[i]);
+        }
+
+        double sipmADC, pmtADC;
+        double sipmTime = peakTime<kSiPMChannel>(adcVal, sipmADC);
+        if (sipmADC > muonThreshold) {
+            // Peak times shift the order by less than one waveform; insert from the back
+            double muonTime = nsTime + sipmTime;
+            muonTimes.insert(upper_bound(muonTimes.begin(), muonTimes.end(), muonTime), muonTime);
+            if (inRange) nMuons++;
+            continue;
+        }
+        if (!inRange || (trigger >= 0 && triggerBits != trigger)) continue;
+
+        double pulseTime = nsTime + peakTime<kPMTChannel>(adcVal, pmtADC);
+        while (!muonTimes.empty() && muonTimes.front() < pulseTime - bufferSpan) muonTimes.pop_front();
+
+        fillWindow(dtOnTime, muonTimes, pulseTime, 0, window);
+        for (int w = 0; w < nWindows; w++) fillWindow(dtOffTime, muonTimes, pulseTime, offset + w * window, window);
+        fillWindow(dtMixed, muonTimes, pulseTime, offset + random.Uniform((nWindows - 1) * window), window);
+        nPulses++;
+    }
+    dtOffTime->Scale(1.0 / nWindows);
+
+    TH1F *dtSubtracted = (TH1F*)dtOnTime->Clone("dtSubtracted");
+    dtSubtracted->SetTitle(TString("Background-subtracted (off-time)") + axes);
+    dtSubtracted->Add(dtOffTime, -1);
+    TH1F *dtSubtractedMixed = (TH1F*)dtOnTime->Clone("dtSubtractedMixed");
+    dtSubtractedMixed->SetTitle(TString("Background-subtracted (mixed events)") + axes);
+    dtSubtractedMixed->Add(dtMixed, -1);
+
+    cout << nMuons << " muons, " << nPulses << " PMT pulses" << endl;
+    cout << "On-time pairs: " << dtOnTime->Integral() << ", accidentals: " << dtOffTime->Integral() << " (off-time), "
+         << dtMixed->Integral() << " (mixed)" << endl;
+    cout << "analyzeMuonDecay pairs (timeDiffHist, a different observable): " << timeDiffHist->Integral() << endl;
+
+    // Plot on-time, accidentals and the subtracted spectrum
+    TCanvas *canvas = new TCanvas("canvas", "Michel accidentals", 800, 600);
+    dtOnTime->SetLineColor(kBlack);
+    dtOffTime->SetLineColor(kRed);
+    dtMixed->SetLineColor(kMagenta);
+    dtSubtracted->SetLineColor(kBlue);
+    dtOnTime->Draw("HIST");
+    dtOffTime->Draw("HIST SAME");
+    dtMixed->Draw("HIST SAME");
+    dtSubtracted->Draw("E SAME");
+    TLegend legend(0.55, 0.65, 0.88, 0.88);
+    legend.AddEntry(dtOnTime, "On time", "l");
+    legend.AddEntry(dtOffTime, "Off-time accidentals", "l");
+    legend.AddEntry(dtMixed, "Mixed-event accidentals", "l");
+    legend.AddEntry(dtSubtracted, "Subtracted", "le");
+    legend.Draw();
+    canvas->SaveAs("michel_accidentals.png");
+    delete canvas;
+
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+    } else {
+        for (int h = 0; h < 4; h++) hists[h]->Write();
+        dtSubtracted->Write();
+        dtSubtractedMixed->Write();
+        TParameter<Long64_t>("nMuons", nMuons).Write();
+        TParameter<Long64_t>("nPulses", nPulses).Write();
+        TParameter<Double_t>("offset", offset).Write();
+        TParameter<Int_t>("offTimeWindows", nWindows).Write();
+        outputFile->Close();
+        cout << "Spectra saved in " << outputName << endl;
+    }
+    delete outputFile;
+
+    for (int h = 0; h < 4; h++) delete hists[h];
+    delete dtSubtracted;
+    delete dtSubtractedMixed;
+    file->Close();
+    delete file;
+}
+
+int main(int argc, char* argv[]) {
+    double window = 10000, offset = 50000; // 10 us window as analyzeMuonDecay; off-time windows start 50 us (> 20 lifetimes) later
+    int nWindows = 10, trigger = -1;
+    UInt_t seed = 4357;
+    EntryRange range;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], range)) {
+                cerr << "Error: invalid entry range " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--window" && i + 1 < argc) window = atof(argv[++i]);
+        else if (arg == "--offset" && i + 1 < argc) offset = atof(argv[++i]);
+        else if (arg == "--windows" && i + 1 < argc) nWindows = atoi(argv[++i]);
+        else if (arg == "--trigger" && i + 1 < argc) trigger = atoi(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = atoi(argv[++i]);
+        else args.push_back(argv[i]);
+    }
+    if (args.size() < 1 || args.size() > 2 || window <= 0 || offset < window || nWindows < 1) {
+        cerr << "Usage: " << argv[0] << " <root_file> [output.root] [--window ns] [--offset ns] [--windows N] [--trigger bits]"
+             << " [--seed S] [--entries begin:end]" << endl;
+        return 1;
+    }
+    InitRunFileIO();
+    michelAccidentals(args[0], (args.size() == 2) ? args[1] : "michel_accidentals.root", range, window, offset, nWindows, trigger,
+                      seed);
+    return 0;
+}
@@ -0,0 +1,342 @@
+//This code scans the afterpulse cuts of the Michel selection (MichelSpectrumwithCuts) over a grid of thresholds in a single pass over the data.
+//The cut parameters are the pulseH multiplier of mu1 (nominal 2), the baselineRMS factor (3), the area/pulseH ratio (1.0) and the
+//peakPositionRMS threshold (2.5). Each one takes a range "min:max:n" on the command line and the grid is their product.
+//Every event is reduced once to the few quantities the cuts compare against (for pulseH/mu1, pulseH/baselineRMS and area/pulseH the
+//bounds over the 12 PMTs, ThresholdBounds, peakPositionRMS and total p.e.); the pass decision of all grid points is then a loop over
+//threshold arrays. At the nominal thresholds it is the decision of ApplyMichelCuts (MichelCuts.h), also for PMTs with mu1 <= 0.
+//For every grid point it fills the Michel spectrum, the pass count and the muon/Michel time-difference distribution, and writes
+//a table (<prefix>_table.txt), the histograms (<prefix>.root) and overlay plots of the spectra; the prefix is cut_scan unless
+//--output PREFIX is given. The time differences are the pairs of analyzeMuonDecay (MuonMichelPairing.h) whose Michel event is a
+//PMT-trigger event passing the cuts of the grid point.
+//With --entries begin:end only the events of those entries are scanned (the gains are still calibrated on the whole run). The
+//pairing starts one window before the range, so every pair is counted by the shard of its Michel event and the histograms of the
+//shards add up in mergeShards.
+#include <iostream>
+#include <fstream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TF1.h>
+#include <TCanvas.h>
+#include <TLegend.h>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include "FastHist.h"
+#include "RunFileIO.h"
+#include "MuonMichelPairing.h"
+#include "DetectorGeometry.h"
+#include "MichelCuts.h"
+
+using namespace std;
+
+// Range of one cut parameter: n values evenly spaced in [min, max]
+struct ScanRange {
+    double min, max;
+    int n;
+    double value(int i) const { return (n == 1) ? min : min + (max - min) * i / (n - 1); }
+};
+
+const double kPairingWindow = 10000; // Muon/Michel window in ns, as analyzeMuonDecay
+
+// "x > k x scale for every PMT" of MichelCuts.h for any k, from one pass over the PMTs: a PMT fails for x <= k x scale, i.e.
+// x / scale <= k if scale > 0, x / scale >= k if scale < 0, and x <= 0 whatever k if scale == 0. NaN comparisons are false in
+// MichelCuts.h, so a NaN never fails there and is ignored here.
+struct ThresholdBounds {
+    double minAbove = numeric_limits<double>::infinity();   // Smallest x / scale of the PMTs with scale > 0
+    double maxBelow = -numeric_limits<double>::infinity();  // Largest x / scale of the PMTs with scale < 0
+    bool failsAlways = false;                                // A PMT with scale == 0 and x <= 0
+
+    void Add(double x, double scale) {
+        if (scale > 0) {
+            double q = x / scale;
+            if (q < minAbove) minAbove = q;
+        } else if (scale < 0) {
+            double q = x / scale;
+            if (q > maxBelow) maxBelow = q;
+        } else if (scale == 0 && x <= 0) {
+            failsAlways = true;
+        }
+    }
+    bool Passes(double k) const { return !failsAlways && minAbove > k && maxBelow < k; }
+};
+
+Double_t SPEfit(Double_t *x, Double_t *par) {
+    Double_t A0 = par[0];
+    Double_t mu0 = par[1];
+    Double_t sigma0 = par[2];
+    Double_t A1 = par[3];
+    Double_t mu1 = par[4];
+    Double_t sigma1 = par[5];
+    Double_t A2 = par[6];
+    Double_t A3 = par[7];
+
+    Double_t term1 = A0 * exp(-0.5 * pow((x[0] - mu0) / sigma0, 2));
+    Double_t term2 = A1 * exp(-0.5 * pow((x[0] - mu1) / sigma1, 2));
+    Double_t term3 = A2 * exp(-0.5 * pow((x[0] - sqrt(2) * mu1) / sqrt(2 * sigma1 * sigma1 - sigma0 * sigma0), 2));
+    Double_t term4 = A3 * exp(-0.5 * pow((x[0] - sqrt(3) * mu1) / sqrt(3 * sigma1 * sigma1 - 2 * sigma0 * sigma0), 2));
+
+    return term1 + term2 + term3 + term4;
+}
+
+// Parse "min:max:n" (or a single value)
+bool parseRange(const char *arg, ScanRange &range) {
+    string s(arg);
+    size_t c1 = s.find(':');
+    if (c1 == string::npos) {
+        range.min = range.max = atof(arg);
+        range.n = 1;
+        return true;
+    }
+    size_t c2 = s.find(':', c1 + 1);
+    if (c2 == string::npos) return false;
+    range.min = atof(s.substr(0, c1).c_str());
+    range.max = atof(s.substr(c1 + 1, c2 - c1 - 1).c_str());
+    range.n = atoi(s.substr(c2 + 1).c_str());
+    return range.n >= 1;
+}
+
+void scanCuts(const char *fileName, ScanRange peRange, ScanRange rmsRange, ScanRange ratioRange, ScanRange ppRange,
+              EntryRange range, const char *outputPrefix = 0) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree!" << endl;
+        file->Close();
+        return;
+    }
+
+    Short_t adcVal[23][45];
+    Double_t area[23], pulseH[23], baselineRMS[23];
+    Int_t peakPosition[23], triggerBits;
+    Long64_t nsTime;
+
+    tree->SetBranchAddress("adcVal", adcVal);
+    tree->SetBranchAddress("area", area);
+    tree->SetBranchAddress("pulseH", pulseH);
+    tree->SetBranchAddress("peakPosition", peakPosition);
+    tree->SetBranchAddress("baselineRMS", baselineRMS);
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+    tree->SetBranchAddress("nsTime", &nsTime);
+
+    // 1. CALIBRATION PHASE
+    vector<FastHist> areaFill;
+    areaFill.reserve(12);
+    for (int i=0; i<12; i++) {
+        areaFill.emplace_back(Form("PMT%d_Area",i+1), Form("PMT %d;ADC Counts;Events",i+1), 150, -50, 400);
+    }
+
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("area", 1);
+    tree->SetBranchStatus("triggerBits", 1);
+    CacheActiveBranches(tree);
+    Long64_t nEntries = tree->GetEntries();
+    PhysicalBlock<Double_t> ledAreas; // LED event areas in physical order, filled one PMT at a time
+    auto fillBlock = [&]() {
+        ForEachChannel<kPMTChannel>([&](int p) { areaFill[p].FillN(ledAreas.Channel(p), ledAreas.Size()); });
+        ledAreas.Clear();
+    };
+    for (Long64_t entry=0; entry<nEntries; entry++) {
+        tree->GetEntry(entry);
+        if (triggerBits != 16) continue;
+        ledAreas.Add(area);
+        if (ledAreas.Full()) fillBlock();
+    }
+    fillBlock();
+    tree->SetBranchStatus("*", 1);
+    CacheActiveBranches(tree);
+
+    Double_t mu1[12] = {0};
+    for (int i=0; i<12; i++) {
+        TH1F *histArea = areaFill[i].ToTH1F();
+        if (histArea->GetEntries() == 0) {
+            cerr << "Empty histogram for PMT " << i+1 << endl;
+            delete histArea;
+            continue;
+        }
+        TF1 *fitFunc = new TF1("fitFunc", SPEfit, -50, 400, 8);
+        fitFunc->SetParameters(1000, 0, 10, 1000, 50, 10, 500, 500);
+        histArea->Fit("fitFunc", "RQ0");
+        mu1[i] = fitFunc->GetParameter(4);
+        cout << "PMT " << i+1 << " (Hardware Channel " << HardwareChannel(i) << "): mu1 = " << mu1[i] << endl;
+        delete fitFunc;
+        delete histArea;
+    }
+
+    // 2. GRID OF CUT CONFIGURATIONS (structure of arrays)
+    int nConfigs = peRange.n * rmsRange.n * ratioRange.n * ppRange.n;
+    vector<float> cutPE, cutRMS, cutRatio, cutPP;
+    for (int a=0; a<peRange.n; a++)
+        for (int b=0; b<rmsRange.n; b++)
+            for (int c=0; c<ratioRange.n; c++)
+                for (int d=0; d<ppRange.n; d++) {
+                    cutPE.push_back(peRange.value(a));
+                    cutRMS.push_back(rmsRange.value(b));
+                    cutRatio.push_back(ratioRange.value(c));
+                    cutPP.push_back(ppRange.value(d));
+                }
+    cout << "Scanning " << nConfigs << " cut configurations" << endl;
+
+    vector<FastHist> michelFill, timeDiffFill;
+    michelFill.reserve(nConfigs);
+    timeDiffFill.reserve(nConfigs);
+    for (int c=0; c<nConfigs; c++) {
+        michelFill.emplace_back(Form("MichelSpectrum_%d", c),
+                                Form("pe>%.2f rms>%.2f ratio>%.2f pprms<%.2f;Photoelectrons (p.e.);Events",
+                                     cutPE[c], cutRMS[c], cutRatio[c], cutPP[c]), 100, 0, 1000);
+        timeDiffFill.emplace_back(Form("timeDiffHist_%d", c),
+                                  Form("pe>%.2f rms>%.2f ratio>%.2f pprms<%.2f;Time Difference [ns];Counts",
+                                       cutPE[c], cutRMS[c], cutRatio[c], cutPP[c]), 100, 0, 10000);
+    }
+    vector<Long64_t> nPass(nConfigs, 0);
+    vector<unsigned char> pass(nConfigs);
+
+    // 3. SINGLE SCAN PASS over the range; the entries of the lead-in only add their muons to the pairing
+    Long64_t nTriggered = 0;
+    MuonMichelPairing pairing(kPairingWindow);
+    vector<double> timeDifferences;
+    ClampEntryRange(range, nEntries);
+    Long64_t firstEntry = LeadInEntry(tree, nsTime, range, kPairingWindow + 45 * 16.0);
+    tree->SetCacheEntryRange(firstEntry, range.end);
+    for (Long64_t entry=firstEntry; entry<range.end; entry++) {
+        tree->GetEntry(entry);
+
+        // Muons for which this event is the Michel electron
+        timeDifferences.clear();
+        pairing.AddEvent(nsTime, adcVal, timeDifferences);
+        if (entry < range.begin) continue;
+
+        if (triggerBits == 2) {
+            nTriggered++;
+
+            // Per-event quantities the cuts compare against
+            // Per-event bounds the cuts compare against, in the form of MichelCuts.h (ApplyMichelCuts at the nominal values)
+            ThresholdBounds peBounds, rmsBounds, ratioBounds;
+            double totalPE = 0;
+            for (int pmt=0; pmt<12; pmt++) {
+                int ch = HardwareChannel(pmt);
+                peBounds.Add(pulseH[ch], mu1[pmt]);            // pulseH > k x mu1
+                rmsBounds.Add(pulseH[ch], baselineRMS[ch]);    // pulseH > k x baselineRMS
+                ratioBounds.Add(area[ch] / pulseH[ch], 1.0);   // area / pulseH > k
+                totalPE += area[ch] / mu1[pmt];
+            }
+            double ppRMS = PeakPositionRMS(peakPosition);
+
+            // Pass decision of every configuration
+            for (int c=0; c<nConfigs; c++) {
+                bool allAbovePE = peBounds.Passes(cutPE[c]);
+                bool conditionB = rmsBounds.Passes(cutRMS[c]) && ratioBounds.Passes(cutRatio[c]);
+                pass[c] = (allAbovePE || conditionB) && (ppRMS < cutPP[c]);
+            }
+            for (int c=0; c<nConfigs; c++) {
+                if (!pass[c]) continue;
+                nPass[c]++;
+                michelFill[c].Fill(totalPE);
+                for (size_t i=0; i<timeDifferences.size(); i++) timeDiffFill[c].Fill(timeDifferences[i]);
+            }
+        }
+    }
+
+    // 4. OUTPUT: table, histograms and overlays
+    TString prefix = outputPrefix ? outputPrefix : "cut_scan";
+    TString plotPrefix = outputPrefix ? outputPrefix : "MichelCutScan";
+    ofstream table((prefix + "_table.txt").Data());
+    table << "# config peCut rmsCut areaRatioCut ppRMSCut nPass efficiency meanPE" << endl;
+    TFile *outputFile = new TFile(prefix + ".root", "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        file->Close();
+        return;
+    }
+    vector<TH1F*> spectra(nConfigs);
+    for (int c=0; c<nConfigs; c++) {
+        spectra[c] = michelFill[c].ToTH1F();
+        TH1F *timeDiff = timeDiffFill[c].ToTH1F();
+        spectra[c]->Write();
+        timeDiff->Write();
+        delete timeDiff;
+        table << c << " " << cutPE[c] << " " << cutRMS[c] << " " << cutRatio[c] << " " << cutPP[c] << " "
+              << nPass[c] << " " << (nTriggered > 0 ? (double)nPass[c] / nTriggered : 0) << " "
+              << spectra[c]->GetMean() << endl;
+    }
+    table.close();
+
+    // One overlay canvas per pulseH multiplier value
+    int perCanvas = nConfigs / peRange.n;
+    for (int a=0; a<peRange.n; a++) {
+        TCanvas *c1 = new TCanvas(Form("c_pe%d", a), "Michel Spectrum Cut Scan", 1000, 800);
+        c1->SetGrid();
+        TLegend *legend = new TLegend(0.55, 0.5, 0.89, 0.89);
+        legend->SetTextSize(0.02);
+        for (int j=0; j<perCanvas; j++) {
+            int c = a * perCanvas + j;
+            spectra[c]->SetLineColor(1 + j % 9);
+            spectra[c]->SetLineStyle(1 + (j / 9) % 10);
+            spectra[c]->Draw(j == 0 ? "HIST" : "HIST SAME");
+            legend->AddEntry(spectra[c], spectra[c]->GetTitle(), "l");
+        }
+        legend->Draw();
+        c1->SaveAs(Form("%s_pe%.2f.png", plotPrefix.Data(), peRange.value(a)));
+        delete legend;
+        delete c1;
+    }
+
+    outputFile->Close();
+    delete outputFile;
+    for (int c=0; c<nConfigs; c++) delete spectra[c];
+    file->Close();
+
+    cout << "Cut scan table written to " << prefix << "_table.txt, histograms to " << prefix << ".root" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    // Nominal cuts of MichelSpectrumwithCuts
+    ScanRange peRange = {2, 2, 1}, rmsRange = {3, 3, 1}, ratioRange = {1, 1, 1}, ppRange = {2.5, 2.5, 1};
+    const char *fileName = 0;
+    const char *outputPrefix = 0;
+    EntryRange entries;
+
+    for (int i=1; i<argc; i++) {
+        string arg = argv[i];
+        ScanRange *range = 0;
+        if (arg == "--pe") range = &peRange;
+        else if (arg == "--rms") range = &rmsRange;
+        else if (arg == "--ratio") range = &ratioRange;
+        else if (arg == "--pprms") range = &ppRange;
+
+        if (arg == "--output" && i + 1 < argc) {
+            outputPrefix = argv[++i];
+        } else if (arg == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], entries)) {
+                cerr << "Error: invalid entry range " << argv[i] << endl;
+                return 1;
+            }
+        } else if (range && i + 1 < argc) {
+            if (!parseRange(argv[++i], *range)) {
+                cerr << "Error: invalid range " << argv[i] << " (expected min:max:n)" << endl;
+                return 1;
+            }
+        } else if (!range && !fileName) {
+            fileName = argv[i];
+        } else {
+            fileName = 0;
+            break;
+        }
+    }
+
+    if (!fileName) {
+        cerr << "Usage: " << argv[0] << " <input_file.root> [--pe min:max:n] [--rms min:max:n] [--ratio min:max:n] [--pprms min:max:n] [--output prefix]"
+             << " [--entries begin:end]" << endl;
+        return 1;
+    }
+    InitRunFileIO();
+    scanCuts(fileName, peRange, rmsRange, ratioRange, ppRange, entries, outputPrefix);
+    return 0;
+}
@@ -0,0 +1,196 @@
+//This code calibrates the PMT gains (mu1, ADC counts per photoelectron) from the occupancy of low light LED events (triggerBits==16),
+//as an alternative to the 8-parameter SPEfit minimization.
+//The number of photoelectrons per LED flash is Poisson distributed (see pd.ipynb), so the fraction of pedestal-only events P0 gives
+//lambda = -ln(P0), and the gain is the mean area above the pedestal divided by lambda:
+//    mu1 = (<area> - <area>_pedestal) / lambda
+//A single streaming pass fills a few counters per PMT, after which each gain is O(1) to compute, so it can also run in live monitoring
+//(--every N prints the running gains every N LED events). With --fit the SPEfit result is computed as a cross-check.
+//With --entries begin:end only those entries are used; the calibrations of the shards are combined by mergeShards.
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TF1.h>
+#include "RunFileIO.h"
+#include "DetectorGeometry.h"
+#include "OccupancyAccumulator.h"
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+Double_t SPEfit(Double_t *x, Double_t *par) {
+    Double_t A0 = par[0];
+    Double_t mu0 = par[1];
+    Double_t sigma0 = par[2];
+    Double_t A1 = par[3];
+    Double_t mu1 = par[4];
+    Double_t sigma1 = par[5];
+    Double_t A2 = par[6];
+    Double_t A3 = par[7];
+
+    Double_t term1 = A0 * exp(-0.5 * pow((x[0] - mu0) / sigma0, 2));
+    Double_t term2 = A1 * exp(-0.5 * pow((x[0] - mu1) / sigma1, 2));
+    Double_t term3 = A2 * exp(-0.5 * pow((x[0] - sqrt(2) * mu1) / sqrt(2 * sigma1 * sigma1 - sigma0 * sigma0), 2));
+    Double_t term4 = A3 * exp(-0.5 * pow((x[0] - sqrt(3) * mu1) / sqrt(3 * sigma1 * sigma1 - 2 * sigma0 * sigma0), 2));
+
+    return term1 + term2 + term3 + term4;
+}
+
+void printGains(const OccupancyAccumulator acc[12]) {
+    for (int pmt = 0; pmt < 12; pmt++) {
+        cout << "PMT " << pmt + 1 << ": lambda = " << acc[pmt].Lambda() << " +/- " << acc[pmt].LambdaError()
+             << ", mu1 = " << acc[pmt].Gain() << " +/- " << acc[pmt].GainError() << endl;
+    }
+}
+
+void calibrateFromOccupancy(const char *fileName, const char *outputName, double pedestalThreshold, bool runFit,
+                            Long64_t printEvery, EntryRange range) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree 'tree'!" << endl;
+        file->Close();
+        return;
+    }
+
+    Double_t area[23];
+    Int_t triggerBits;
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("area", 1);
+    tree->SetBranchStatus("triggerBits", 1);
+    tree->SetBranchAddress("area", area);
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+    CacheActiveBranches(tree);
+
+    // Area histograms are only needed for the optional SPEfit cross-check
+    TH1F *histArea[12] = {0};
+    if (runFit) {
+        for (int i = 0; i < 12; i++) {
+            histArea[i] = new TH1F(Form("PMT%d_Area", i + 1), Form("PMT %d;ADC Counts;Events", i + 1), 150, -50, 400);
+        }
+    }
+
+    // Streaming pass over the LED events
+    OccupancyAccumulator acc[12];
+    Long64_t nLED = 0;
+    ClampEntryRange(range, tree->GetEntries());
+    tree->SetCacheEntryRange(range.begin, range.end);
+    for (Long64_t entry = range.begin; entry < range.end; entry++) {
+        tree->GetEntry(entry);
+        if (triggerBits != 16) continue;
+        nLED++;
+
+        for (int pmt = 0; pmt < 12; pmt++) {
+            double value = area[HardwareChannel(pmt)];
+            acc[pmt].Fill(value, pedestalThreshold);
+            if (runFit) histArea[pmt]->Fill(value);
+        }
+
+        if (printEvery > 0 && nLED % printEvery == 0) {
+            cout << "--- After " << nLED << " LED events ---" << endl;
+            printGains(acc);
+        }
+    }
+
+    cout << "Occupancy calibration from " << nLED << " LED events (pedestal threshold " << pedestalThreshold << " ADC):" << endl;
+    printGains(acc);
+
+    // Optional cross-check with the SPEfit minimization
+    Double_t fitMu1[12];
+    for (int i = 0; i < 12; i++) {
+        fitMu1[i] = -1;
+        if (!runFit || histArea[i]->GetEntries() == 0) continue;
+        TF1 *fitFunc = new TF1("fitFunc", SPEfit, -50, 400, 8);
+        fitFunc->SetParameters(1000, 0, 10, 1000, 50, 10, 500, 500);
+        histArea[i]->Fit("fitFunc", "RQ0");
+        fitMu1[i] = fitFunc->GetParameter(4);
+        cout << "PMT " << i + 1 << ": SPEfit mu1 = " << fitMu1[i]
+             << ", occupancy mu1 = " << acc[i].Gain() << endl;
+        delete fitFunc;
+    }
+
+    // Save the calibration table
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        file->Close();
+        return;
+    }
+    Int_t pmtNumber;
+    Long64_t nEvents, nPedestal;
+    Double_t sumArea, sumPedestal, lambda, lambdaErr, gain, gainErr, spefitMu1;
+    TTree *calibTree = new TTree("occupancyCalibration", "Occupancy gain calibration");
+    calibTree->Branch("pmt", &pmtNumber, "pmt/I");
+    calibTree->Branch("nEvents", &nEvents, "nEvents/L");
+    calibTree->Branch("nPedestal", &nPedestal, "nPedestal/L");
+    calibTree->Branch("sumArea", &sumArea, "sumArea/D");
+    calibTree->Branch("sumPedestal", &sumPedestal, "sumPedestal/D");
+    calibTree->Branch("lambda", &lambda, "lambda/D");
+    calibTree->Branch("lambdaErr", &lambdaErr, "lambdaErr/D");
+    calibTree->Branch("mu1", &gain, "mu1/D");
+    calibTree->Branch("mu1Err", &gainErr, "mu1Err/D");
+    calibTree->Branch("spefitMu1", &spefitMu1, "spefitMu1/D");
+    for (int i = 0; i < 12; i++) {
+        pmtNumber = i + 1;
+        nEvents = acc[i].nEvents;
+        nPedestal = acc[i].nPedestal;
+        sumArea = acc[i].sumArea;
+        sumPedestal = acc[i].sumPedestal;
+        lambda = acc[i].Lambda();
+        lambdaErr = acc[i].LambdaError();
+        gain = acc[i].Gain();
+        gainErr = acc[i].GainError();
+        spefitMu1 = fitMu1[i];
+        calibTree->Fill();
+    }
+    calibTree->Write();
+    for (int i = 0; i < 12; i++) {
+        if (histArea[i]) histArea[i]->Write();
+    }
+    outputFile->Close();
+    delete outputFile;
+
+    for (int i = 0; i < 12; i++) delete histArea[i];
+    file->Close();
+    cout << "Calibration saved in " << outputName << endl;
+}
+
+int main(int argc, char* argv[]) {
+    const char *fileName = 0;
+    double pedestalThreshold = 20; // ADC counts; between the pedestal (mu0 ~ 0) and the single p.e. peak
+    bool runFit = false;
+    Long64_t printEvery = 0;
+    const char *outputName = "occupancy_calibration.root";
+    EntryRange range;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--fit") runFit = true;
+        else if (arg == "--threshold" && i + 1 < argc) pedestalThreshold = atof(argv[++i]);
+        else if (arg == "--every" && i + 1 < argc) printEvery = atoll(argv[++i]);
+        else if (arg == "--output" && i + 1 < argc) outputName = argv[++i];
+        else if (arg == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], range)) {
+                cerr << "Error: invalid entry range " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else fileName = argv[i];
+    }
+
+    if (!fileName) {
+        cerr << "Usage: " << argv[0] << " <root_file> [--threshold ADC] [--fit] [--every N] [--entries begin:end] [--output file.root]" << endl;
+        return 1;
+    }
+    InitRunFileIO();
+    calibrateFromOccupancy(fileName, outputName, pedestalThreshold, runFit, printEvery, range);
+    return 0;
+}
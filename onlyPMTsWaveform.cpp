@@ -11,6 +11,7 @@
 #include <algorithm>
 #include <cmath>
 #include "TLatex.h"
+#include "WaveformCodec.h"
 
 using namespace std;
 
@@ -42,7 +43,7 @@ void lowlight(const char *fileName, int EventID) {
     Double_t baselineMean[23]; // Baseline mean for each channel
 
     // Set branch addresses to read data from the TTree
-    tree->SetBranchAddress("adcVal", adcVal);
+    WaveformReader waveforms(tree, adcVal); // Raw adcVal or packed waveforms
     tree->SetBranchAddress("area", area);
     tree->SetBranchAddress("baselineMean", baselineMean);
 
@@ -56,6 +57,11 @@ void lowlight(const char *fileName, int EventID) {
 
     // Load the specified event into memory
     tree->GetEntry(EventID);
+    if (!waveforms.Decode()) {
+        cerr << "Error: corrupt packed waveforms in event " << EventID << endl;
+        file->Close();
+        return;
+    }
 
     // Find the maximum ADC value across all channels and time bins for this event
     double maxADC = 0;
@@ -140,26 +146,26 @@ void lowlight(const char *fileName, int EventID) {
             graph->Draw("AL"); // Draw the graph
 
             // Add the title to the plot
-            TLatex *latexTitle = new TLatex();
-            latexTitle->SetTextSize(0.12);
-            latexTitle->SetTextAlign(22);
-            latexTitle->SetNDC(true);
-            latexTitle->DrawLatex(0.5, 0.94, title);
+            TLatex latexTitle;
+            latexTitle.SetTextSize(0.12);
+            latexTitle.SetTextAlign(22);
+            latexTitle.SetNDC(true);
+            latexTitle.DrawLatex(0.5, 0.94, title);
 
             // Add area and baselineMean information with colored text
-            TLatex *infoArea = new TLatex();
-            infoArea->SetTextSize(0.04);
-            infoArea->SetTextAlign(13);
-            infoArea->SetNDC(true);
-            infoArea->SetTextColor(kBlue); // Blue color for Area
-            infoArea->DrawLatex(0.2, 0.85, Form("Area: %.2f", area[adcIndex]));
-
-            TLatex *infoBaseline = new TLatex();
-            infoBaseline->SetTextSize(0.04);
-            infoBaseline->SetTextAlign(13);
-            infoBaseline->SetNDC(true);
-            infoBaseline->SetTextColor(kRed); // Red color for Baseline Mean
-            infoBaseline->DrawLatex(0.2, 0.80, Form("Baseline Mean: %.2f", baselineMean[adcIndex]));
+            TLatex infoArea;
+            infoArea.SetTextSize(0.04);
+            infoArea.SetTextAlign(13);
+            infoArea.SetNDC(true);
+            infoArea.SetTextColor(kBlue); // Blue color for Area
+            infoArea.DrawLatex(0.2, 0.85, Form("Area: %.2f", area[adcIndex]));
+
+            TLatex infoBaseline;
+            infoBaseline.SetTextSize(0.04);
+            infoBaseline.SetTextAlign(13);
+            infoBaseline.SetNDC(true);
+            infoBaseline.SetTextColor(kRed); // Red color for Baseline Mean
+            infoBaseline.DrawLatex(0.2, 0.80, Form("Baseline Mean: %.2f", baselineMean[adcIndex]));
         }
     }
 
@@ -195,19 +201,19 @@ void lowlight(const char *fileName, int EventID) {
         graph->Draw("AL");
 
         // Add area and baselineMean information with colored text
-        TLatex *infoArea = new TLatex();
-        infoArea->SetTextSize(0.04);
-        infoArea->SetTextAlign(13);
-        infoArea->SetNDC(true);
-        infoArea->SetTextColor(kBlue); // Blue color for Area
-        infoArea->DrawLatex(0.2, 0.85, Form("Area: %.2f", area[adcIndex]));
-
-        TLatex *infoBaseline = new TLatex();
-        infoBaseline->SetTextSize(0.04);
-        infoBaseline->SetTextAlign(13);
-        infoBaseline->SetNDC(true);
-        infoBaseline->SetTextColor(kRed); // Red color for Baseline Mean
-        infoBaseline->DrawLatex(0.2, 0.80, Form("Baseline Mean: %.2f", baselineMean[adcIndex]));
+        TLatex infoArea;
+        infoArea.SetTextSize(0.04);
+        infoArea.SetTextAlign(13);
+        infoArea.SetNDC(true);
+        infoArea.SetTextColor(kBlue); // Blue color for Area
+        infoArea.DrawLatex(0.2, 0.85, Form("Area: %.2f", area[adcIndex]));
+
+        TLatex infoBaseline;
+        infoBaseline.SetTextSize(0.04);
+        infoBaseline.SetTextAlign(13);
+        infoBaseline.SetNDC(true);
+        infoBaseline.SetTextColor(kRed); // Red color for Baseline Mean
+        infoBaseline.DrawLatex(0.2, 0.80, Form("Baseline Mean: %.2f", baselineMean[adcIndex]));
 
         individualCanvas->SaveAs(individualPMTFileName);
         delete individualCanvas;
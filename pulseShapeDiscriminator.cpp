@@ -0,0 +1,258 @@
+//This code runs a matched-filter pulse-shape discrimination on the raw PMT waveforms (adcVal) for fast afterpulse rejection.
+//Pass 1 learns a pulse template for each PMT from clean PMT-triggered (triggerBits==2) pulses: baseline subtracted, peak aligned and amplitude normalized.
+//Pass 2 correlates every PMT waveform of every event against its template, in blocks of events laid out sample-major so the
+//inner loops run over events and are vectorized by the compiler (build with -O3 -march=native).
+//For each PMT it writes a shape score (normalized correlation, 1 = template shape) and a sub-sample pulse time (ns)
+//to the tree "psdTree" with one entry per input entry, so it can be used as a friend of the input tree.
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TH1F.h>
+#include <TCanvas.h>
+#include "RunFileIO.h"
+#include "DetectorGeometry.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const int nSamples = 45;          // Samples per waveform (16 ns each)
+const int nBaselineSamples = 8;   // Leading samples used for the baseline
+const int templatePre = 4;        // Template samples before the peak
+const int templateLength = 16;    // Template samples in total
+const int nLags = nSamples - templateLength + 1;
+const int blockSize = 256;        // Events correlated together
+const Long64_t maxTemplatePulses = 20000; // Pulses averaged per PMT template
+
+// Pulse height window (ADC above baseline) of pulses used to build the templates
+const double templateMinHeight = 20;
+const double templateMaxHeight = 1000;
+
+// Learn the normalized template of each PMT from clean single pulses in PMT-triggered events
+void buildTemplates(TTree *tree, Short_t adcVal[23][45], Int_t &triggerBits, float templates[12][templateLength]) {
+    double sum[12][templateLength] = {{0}};
+    Long64_t nUsed[12] = {0};
+
+    Long64_t nEntries = tree->GetEntries();
+    for (Long64_t entry = 0; entry < nEntries; entry++) {
+        tree->GetEntry(entry);
+        if (triggerBits != 2) continue;
+
+        bool allFull = true;
+        for (int pmt = 0; pmt < 12; pmt++) {
+            if (nUsed[pmt] >= maxTemplatePulses) continue;
+            allFull = false;
+            const Short_t *wf = adcVal[HardwareChannel(pmt)];
+
+            double baseline = 0;
+            for (int k = 0; k < nBaselineSamples; k++) baseline += wf[k];
+            baseline /= nBaselineSamples;
+
+            int peak = 0;
+            for (int k = 1; k < nSamples; k++) if (wf[k] > wf[peak]) peak = k;
+            double height = wf[peak] - baseline;
+            if (height < templateMinHeight || height > templateMaxHeight) continue;
+            if (peak - templatePre < nBaselineSamples || peak - templatePre + templateLength > nSamples) continue;
+
+            for (int j = 0; j < templateLength; j++) {
+                sum[pmt][j] += (wf[peak - templatePre + j] - baseline) / height;
+            }
+            nUsed[pmt]++;
+        }
+        if (allFull) break;
+    }
+
+    // Normalize each template to unit length so the correlation is a cosine similarity
+    for (int pmt = 0; pmt < 12; pmt++) {
+        double norm = 0;
+        for (int j = 0; j < templateLength; j++) norm += sum[pmt][j] * sum[pmt][j];
+        norm = sqrt(norm);
+        if (nUsed[pmt] == 0 || norm == 0) {
+            cerr << "No template pulses for PMT " << pmt + 1 << ", using a delta template" << endl;
+            for (int j = 0; j < templateLength; j++) templates[pmt][j] = (j == templatePre) ? 1 : 0;
+            continue;
+        }
+        for (int j = 0; j < templateLength; j++) templates[pmt][j] = sum[pmt][j] / norm;
+        cout << "PMT " << pmt + 1 << ": template from " << nUsed[pmt] << " pulses" << endl;
+    }
+}
+
+// Correlate one channel of a block of events against its template.
+// wf is sample-major: wf[k * blockSize + ev] is sample k of event ev.
+void correlateBlock(const float *wf, int nEv, const float tmpl[templateLength],
+                    float *score, float *pulseTime) {
+    float bestDot[blockSize], prevDot[blockSize], bestPrev[blockSize], bestNext[blockSize];
+    float bestEnergy[blockSize];
+    int bestLag[blockSize];
+    for (int ev = 0; ev < nEv; ev++) {
+        bestDot[ev] = -1e30f;
+        prevDot[ev] = 0;
+        bestPrev[ev] = 0;
+        bestNext[ev] = 0;
+        bestEnergy[ev] = 0;
+        bestLag[ev] = 0;
+    }
+
+    for (int lag = 0; lag < nLags; lag++) {
+        float dot[blockSize], energy[blockSize];
+        for (int ev = 0; ev < nEv; ev++) {
+            dot[ev] = 0;
+            energy[ev] = 0;
+        }
+        for (int j = 0; j < templateLength; j++) {
+            const float t = tmpl[j];
+            const float *row = wf + (lag + j) * blockSize;
+            for (int ev = 0; ev < nEv; ev++) {
+                dot[ev] += t * row[ev];
+                energy[ev] += row[ev] * row[ev];
+            }
+        }
+        // Track the maximum and its neighbours for the parabolic time interpolation
+        for (int ev = 0; ev < nEv; ev++) {
+            bool better = dot[ev] > bestDot[ev];
+            if (lag == bestLag[ev] + 1) bestNext[ev] = dot[ev];
+            if (better) {
+                bestPrev[ev] = prevDot[ev];
+                bestNext[ev] = dot[ev];
+                bestDot[ev] = dot[ev];
+                bestEnergy[ev] = energy[ev];
+                bestLag[ev] = lag;
+            }
+            prevDot[ev] = dot[ev];
+        }
+    }
+
+    for (int ev = 0; ev < nEv; ev++) {
+        score[ev] = bestEnergy[ev] > 0 ? bestDot[ev] / sqrt(bestEnergy[ev]) : 0;
+
+        float delta = 0;
+        bool interior = bestLag[ev] > 0 && bestLag[ev] < nLags - 1;
+        float denom = bestPrev[ev] - 2 * bestDot[ev] + bestNext[ev];
+        if (interior && denom < 0) delta = 0.5f * (bestPrev[ev] - bestNext[ev]) / denom;
+        pulseTime[ev] = (bestLag[ev] + templatePre + delta + 1) * 16.0f;
+    }
+}
+
+void discriminatePulseShapes(const char *fileName, const char *outputName) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree 'tree'!" << endl;
+        file->Close();
+        return;
+    }
+
+    Short_t adcVal[23][45];
+    Int_t triggerBits;
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("adcVal", 1);
+    tree->SetBranchStatus("triggerBits", 1);
+    tree->SetBranchAddress("adcVal", adcVal);
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+    CacheActiveBranches(tree);
+
+    // 1. TEMPLATE LEARNING
+    float templates[12][templateLength];
+    buildTemplates(tree, adcVal, triggerBits, templates);
+
+    // 2. BLOCKED CORRELATION
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        file->Close();
+        return;
+    }
+
+    Float_t shapeScore[12], pulseTime[12];
+    TTree *psdTree = new TTree("psdTree", "Matched-filter pulse-shape discrimination");
+    psdTree->Branch("shapeScore", shapeScore, "shapeScore[12]/F");
+    psdTree->Branch("pulseTime", pulseTime, "pulseTime[12]/F");
+
+    TH1F *histScore[12];
+    for (int i = 0; i < 12; i++) {
+        histScore[i] = new TH1F(Form("PMT%d_ShapeScore", i + 1),
+                                Form("PMT %d;Shape score;Events", i + 1), 200, -1, 1);
+    }
+
+    // Baseline-subtracted waveforms of one block, channel by channel, sample-major
+    vector<float> block(12 * nSamples * blockSize);
+    vector<float> blockScore(12 * blockSize), blockTime(12 * blockSize);
+
+    Long64_t nEntries = tree->GetEntries();
+    for (Long64_t first = 0; first < nEntries; first += blockSize) {
+        int nEv = (int)min<Long64_t>(blockSize, nEntries - first);
+
+        for (int ev = 0; ev < nEv; ev++) {
+            tree->GetEntry(first + ev);
+            for (int pmt = 0; pmt < 12; pmt++) {
+                const Short_t *wf = adcVal[HardwareChannel(pmt)];
+                float baseline = 0;
+                for (int k = 0; k < nBaselineSamples; k++) baseline += wf[k];
+                baseline /= nBaselineSamples;
+                float *dst = &block[pmt * nSamples * blockSize];
+                for (int k = 0; k < nSamples; k++) dst[k * blockSize + ev] = wf[k] - baseline;
+            }
+        }
+
+        for (int pmt = 0; pmt < 12; pmt++) {
+            correlateBlock(&block[pmt * nSamples * blockSize], nEv, templates[pmt],
+                           &blockScore[pmt * blockSize], &blockTime[pmt * blockSize]);
+        }
+
+        for (int ev = 0; ev < nEv; ev++) {
+            for (int pmt = 0; pmt < 12; pmt++) {
+                shapeScore[pmt] = blockScore[pmt * blockSize + ev];
+                pulseTime[pmt] = blockTime[pmt * blockSize + ev];
+                histScore[pmt]->Fill(shapeScore[pmt]);
+            }
+            psdTree->Fill();
+        }
+    }
+
+    // 3. OUTPUT
+    outputFile->cd();
+    psdTree->Write();
+    for (int i = 0; i < 12; i++) {
+        TH1F *histTemplate = new TH1F(Form("PMT%d_Template", i + 1),
+                                      Form("PMT %d template;Sample;Normalized amplitude", i + 1),
+                                      templateLength, -templatePre, templateLength - templatePre);
+        for (int j = 0; j < templateLength; j++) histTemplate->SetBinContent(j + 1, templates[i][j]);
+        histTemplate->Write();
+        histScore[i]->Write();
+        delete histTemplate;
+    }
+
+    TCanvas *canvas = new TCanvas("canvas", "PMT Shape Scores", 1200, 1600);
+    canvas->Divide(3, 4);
+    for (int i = 0; i < 12; i++) {
+        canvas->cd(i + 1);
+        gPad->SetLogy();
+        histScore[i]->Draw();
+    }
+    canvas->SaveAs("pulse_shape_scores.png");
+    delete canvas;
+
+    cout << "Shape scores of " << nEntries << " events written to " << outputName << " (tree psdTree)" << endl;
+
+    for (int i = 0; i < 12; i++) delete histScore[i];
+    outputFile->Close();
+    delete outputFile;
+    file->Close();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        cerr << "Usage: " << argv[0] << " <root_file> [output.root]" << endl;
+        return 1;
+    }
+    const char *outputName = (argc == 3) ? argv[2] : "psd_output.root";
+    InitRunFileIO();
+    discriminatePulseShapes(argv[1], outputName);
+    return 0;
+}
@@ -0,0 +1,97 @@
+//This code is the command line client of queryDaemon. The words after the socket path form the query (see queryDaemon.cpp):
+//    ./queryClient /tmp/rootquery.sock hist run=21672 var=baselineRMS ch=14 bins=100 min=0 max=10 --png baselineRMS_ch14.png
+//    ./queryClient /tmp/rootquery.sock count run=21672 trigger=2 cut=pulseH:pmt5:50:1e9
+//A histogram reply is drawn and saved as a PNG (query_hist.png by default) and its entries, mean and RMS are printed;
+//other replies are printed as they are.
+#include <iostream>
+#include <sstream>
+#include <TH1F.h>
+#include <TCanvas.h>
+#include <TStyle.h>
+#include <string>
+#include <cstdio>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Send one request line and return the whole reply, or "" if the server cannot be reached
+string sendQuery(const char *socketPath, const string &query) {
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socketPath);
+    if (sock < 0 || connect(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Error connecting to the query server");
+        if (sock >= 0) close(sock);
+        return "";
+    }
+
+    string line = query + "\n";
+    for (size_t sent = 0; sent < line.size();) {
+        ssize_t n = write(sock, line.data() + sent, line.size() - sent);
+        if (n <= 0) break;
+        sent += n;
+    }
+
+    string reply;
+    char buffer[65536];
+    ssize_t n;
+    while ((n = read(sock, buffer, sizeof(buffer))) > 0) reply.append(buffer, n);
+    close(sock);
+    return reply;
+}
+
+// Draw the histogram of a "OK hist" reply
+void drawHistogram(const string &reply, const string &query, const char *pngName) {
+    istringstream in(reply);
+    string ok, kind;
+    int nBins;
+    double xMin, xMax, ms;
+    Long64_t nEntries;
+    in >> ok >> kind >> nBins >> xMin >> xMax >> nEntries >> ms;
+
+    TH1F *hist = new TH1F("queryHist", (query + ";Value;Counts").c_str(), nBins, xMin, xMax);
+    for (int b = 0; b < nBins + 2; b++) {
+        double count = 0;
+        in >> count;
+        hist->SetBinContent(b, count);
+    }
+    hist->SetEntries(nEntries);
+
+    cout << "Entries: " << nEntries << ", mean: " << hist->GetMean() << ", RMS: " << hist->GetRMS()
+         << " (server time " << ms << " ms)" << endl;
+
+    gStyle->SetOptStat(1110);
+    TCanvas *canvas = new TCanvas("canvas", "Query", 800, 600);
+    hist->SetLineColor(kBlue);
+    hist->Draw();
+    canvas->SaveAs(pngName);
+
+    delete canvas;
+    delete hist;
+}
+
+int main(int argc, char* argv[]) {
+    const char *pngName = "query_hist.png";
+    string query;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--png" && i + 1 < argc) pngName = argv[++i];
+        else query += (query.empty() ? "" : " ") + arg;
+    }
+    if (argc < 3 || query.empty()) {
+        cerr << "Usage: " << argv[0] << " <socket_path> <command> [key=value ...] [--png out.png]" << endl;
+        return 1;
+    }
+
+    string reply = sendQuery(argv[1], query);
+    if (reply.empty()) return 1;
+    if (reply.compare(0, 7, "OK hist") == 0) {
+        drawHistogram(reply, query, pngName);
+    } else {
+        cout << reply;
+    }
+    return reply.compare(0, 5, "ERROR") == 0 ? 1 : 0;
+}
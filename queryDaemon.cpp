@@ -0,0 +1,334 @@
+//This code is a resident query server for quick looks at run data. It loads the reduced per-channel columns (area, pulseH,
+//baselineRMS, baselineMean, peakPosition of the 23 channels, and triggerBits) of the given runs into memory once and answers
+//histogram, count and event-list queries on a UNIX socket, so an ad-hoc question does not rescan the file:
+//    ./queryDaemon /tmp/rootquery.sock run21672_processed_v5.root run21673_processed_v5.root &
+//    ./queryClient /tmp/rootquery.sock hist run=21672 var=baselineRMS ch=14 bins=100 min=0 max=10
+//    ./queryClient /tmp/rootquery.sock hist run=21672 var=pulseH pmt=5 bins=100 min=0 max=2000 trigger=2
+//
+//Protocol: one request line per connection, "command key=value ...", answered by text lines, then the connection is closed.
+//A request longer than kMaxRequestLine bytes, or not complete within kClientTimeout seconds, is answered with an ERROR line, so a
+//stalled client cannot block the server.
+//    runs                                                      -> OK runs <n>, then "run entries path" per run
+//    hist  run=R|all var=V ch=C|pmt=P|ch=all bins=N min=A max=B -> OK hist <bins> <min> <max> <entries> <ms>, then the bin contents
+//                                                                 0..bins+1 (underflow and overflow included)
+//    count run=R|all                                           -> OK count <n> <ms>
+//    events run=R [limit=N]                                    -> OK events <n> <ms>, then the entry numbers
+//    shutdown                                                  -> OK shutdown, and the server exits
+//Selections for hist, count and events: trigger=T (triggerBits==T) and any number of cut=var:ch:min:max (min <= value < max,
+//ch may be pmtN). Channels are hardware channels 0-22; pmt=P is PMT P (1-12) through the channel map.
+#include <iostream>
+#include <sstream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TSystem.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "RunFileIO.h"
+#include "DetectorGeometry.h"
+
+using namespace std;
+
+const size_t kMaxRequestLine = 4096;
+const int kClientTimeout = 5; // Seconds a client may take to send its request or to accept a reply
+
+const int nQueryVars = 5;
+const char *queryVarNames[nQueryVars] = {"area", "pulseH", "baselineRMS", "baselineMean", "peakPosition"};
+
+// Reduced columns of one run, channel-major so a query reads one contiguous array
+struct RunColumns {
+    int run = -1;
+    string path;
+    Long64_t nEntries = 0;
+    vector<float> values[nQueryVars][23];
+    vector<Int_t> triggerBits;
+};
+
+struct Cut {
+    int var, ch;
+    double lo, hi;
+};
+
+struct Query {
+    string command;
+    map<string, string> options;
+    vector<Cut> cuts;
+    int trigger = -1;
+};
+
+int findVar(const string &name) {
+    for (int v = 0; v < nQueryVars; v++) {
+        if (name == queryVarNames[v]) return v;
+    }
+    return -1;
+}
+
+// Hardware channel from "14" or "pmt5"; -1 if invalid
+int parseChannel(const string &text) {
+    if (text.compare(0, 3, "pmt") == 0) {
+        int pmt = atoi(text.c_str() + 3);
+        return (pmt >= 1 && pmt <= kNumPMTs) ? HardwareChannel(pmt - 1) : -1;
+    }
+    int ch = atoi(text.c_str());
+    return (ch >= 0 && ch < 23 && !text.empty()) ? ch : -1;
+}
+
+bool loadRun(const char *fileName, RunColumns &columns) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return false;
+    }
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree in " << fileName << endl;
+        file->Close();
+        return false;
+    }
+
+    Double_t buffers[nQueryVars][23];
+    Int_t peakPosition[23], triggerBits;
+    bool present[nQueryVars];
+    tree->SetBranchStatus("*", 0);
+    for (int v = 0; v < nQueryVars; v++) {
+        present[v] = tree->GetBranch(queryVarNames[v]) != 0;
+        if (!present[v]) {
+            cerr << "Warning: no branch " << queryVarNames[v] << " in " << fileName << endl;
+            continue;
+        }
+        tree->SetBranchStatus(queryVarNames[v], 1);
+        if (string(queryVarNames[v]) == "peakPosition") tree->SetBranchAddress(queryVarNames[v], peakPosition);
+        else tree->SetBranchAddress(queryVarNames[v], buffers[v]);
+    }
+    tree->SetBranchStatus("triggerBits", 1);
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+    CacheActiveBranches(tree);
+
+    columns.path = fileName;
+    sscanf(gSystem->BaseName(fileName), "run%d", &columns.run);
+    columns.nEntries = tree->GetEntries();
+    for (int v = 0; v < nQueryVars; v++) {
+        if (!present[v]) continue;
+        for (int ch = 0; ch < 23; ch++) columns.values[v][ch].resize(columns.nEntries);
+    }
+    columns.triggerBits.resize(columns.nEntries);
+
+    for (Long64_t entry = 0; entry < columns.nEntries; entry++) {
+        tree->GetEntry(entry);
+        columns.triggerBits[entry] = triggerBits;
+        for (int v = 0; v < nQueryVars; v++) {
+            if (!present[v]) continue;
+            bool isPeak = (string(queryVarNames[v]) == "peakPosition");
+            for (int ch = 0; ch < 23; ch++) columns.values[v][ch][entry] = isPeak ? peakPosition[ch] : buffers[v][ch];
+        }
+    }
+    file->Close();
+    delete file;
+    cout << "Loaded run " << columns.run << ": " << columns.nEntries << " entries from " << fileName << endl;
+    return true;
+}
+
+// Parse "command key=value ..."; returns an error message or "" if the query is valid
+string parseQuery(const string &line, Query &query) {
+    istringstream words(line);
+    words >> query.command;
+    string word;
+    while (words >> word) {
+        size_t eq = word.find('=');
+        if (eq == string::npos) return "expected key=value, got " + word;
+        string key = word.substr(0, eq), value = word.substr(eq + 1);
+        if (key == "cut") {
+            Cut cut;
+            char varName[64], chName[16];
+            if (sscanf(value.c_str(), "%63[^:]:%15[^:]:%lf:%lf", varName, chName, &cut.lo, &cut.hi) != 4) return "bad cut " + value;
+            cut.var = findVar(varName);
+            cut.ch = parseChannel(chName);
+            if (cut.var < 0 || cut.ch < 0) return "bad cut " + value;
+            query.cuts.push_back(cut);
+        } else if (key == "trigger") {
+            query.trigger = atoi(value.c_str());
+        } else {
+            query.options[key] = value;
+        }
+    }
+    return "";
+}
+
+bool passes(const RunColumns &columns, const Query &query, Long64_t entry) {
+    if (query.trigger >= 0 && columns.triggerBits[entry] != query.trigger) return false;
+    for (size_t c = 0; c < query.cuts.size(); c++) {
+        const Cut &cut = query.cuts[c];
+        const vector<float> &values = columns.values[cut.var][cut.ch];
+        if (values.empty()) return false;
+        float value = values[entry];
+        if (value < cut.lo || value >= cut.hi) return false;
+    }
+    return true;
+}
+
+string answer(const string &line, vector<RunColumns> &runs, bool &stop) {
+    auto start = chrono::steady_clock::now();
+    Query query;
+    string error = parseQuery(line, query);
+    if (!error.empty()) return "ERROR " + error + "\n";
+
+    ostringstream out;
+    if (query.command == "runs") {
+        out << "OK runs " << runs.size() << "\n";
+        for (size_t r = 0; r < runs.size(); r++) out << runs[r].run << " " << runs[r].nEntries << " " << runs[r].path << "\n";
+        return out.str();
+    }
+    if (query.command == "shutdown") {
+        stop = true;
+        return "OK shutdown\n";
+    }
+
+    // Runs of the query
+    vector<RunColumns*> selected;
+    string runOption = query.options.count("run") ? query.options["run"] : "";
+    for (size_t r = 0; r < runs.size(); r++) {
+        if (runOption == "all" || atoi(runOption.c_str()) == runs[r].run) selected.push_back(&runs[r]);
+    }
+    if (selected.empty()) return "ERROR run " + runOption + " is not loaded\n";
+
+    Long64_t nPassed = 0;
+    ostringstream data;
+    if (query.command == "hist") {
+        int var = findVar(query.options["var"]);
+        string chOption = query.options.count("pmt") ? "pmt" + query.options["pmt"] : query.options["ch"];
+        bool allChannels = (chOption == "all");
+        int ch = allChannels ? 0 : parseChannel(chOption);
+        int nBins = atoi(query.options["bins"].c_str());
+        double xMin = atof(query.options["min"].c_str()), xMax = atof(query.options["max"].c_str());
+        if (var < 0 || ch < 0 || nBins < 1 || xMax <= xMin) return "ERROR hist needs var, ch|pmt, bins, min < max\n";
+
+        vector<Long64_t> counts(nBins + 2, 0);
+        double scale = nBins / (xMax - xMin);
+        for (size_t r = 0; r < selected.size(); r++) {
+            RunColumns &columns = *selected[r];
+            for (int c = allChannels ? 0 : ch; c < (allChannels ? 23 : ch + 1); c++) {
+                const vector<float> &values = columns.values[var][c];
+                if (values.empty()) return string("ERROR ") + queryVarNames[var] + " not loaded\n";
+                for (Long64_t entry = 0; entry < columns.nEntries; entry++) {
+                    if (!passes(columns, query, entry)) continue;
+                    double bin = (values[entry] - xMin) * scale + 1;
+                    int b = !(bin >= 0) ? 0 : (bin >= nBins + 1) ? nBins + 1 : (int)bin; // NaN to underflow, as FastHist
+                    counts[b]++;
+                    nPassed++;
+                }
+            }
+        }
+        for (int b = 0; b < nBins + 2; b++) data << counts[b] << (b == nBins + 1 ? "\n" : " ");
+        out << "OK hist " << nBins << " " << xMin << " " << xMax << " " << nPassed;
+    } else if (query.command == "count" || query.command == "events") {
+        Long64_t limit = query.options.count("limit") ? atoll(query.options["limit"].c_str()) : -1;
+        if (query.command == "events" && selected.size() != 1) return "ERROR events needs a single run\n";
+        for (size_t r = 0; r < selected.size(); r++) {
+            RunColumns &columns = *selected[r];
+            for (Long64_t entry = 0; entry < columns.nEntries; entry++) {
+                if (!passes(columns, query, entry)) continue;
+                if (query.command == "events" && (limit < 0 || nPassed < limit)) data << entry << "\n";
+                nPassed++;
+            }
+        }
+        out << "OK " << query.command << " " << nPassed;
+    } else {
+        return "ERROR unknown command " + query.command + "\n";
+    }
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    out << " " << ms << "\n" << data.str();
+    return out.str();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <socket_path> <run.root> [run.root ...]" << endl;
+        return 1;
+    }
+    const char *socketPath = argv[1];
+
+    InitRunFileIO();
+    vector<RunColumns> runs(argc - 2);
+    size_t nLoaded = 0;
+    for (int i = 2; i < argc; i++) {
+        if (loadRun(argv[i], runs[nLoaded])) nLoaded++;
+    }
+    runs.resize(nLoaded);
+    if (runs.empty()) {
+        cerr << "No runs loaded" << endl;
+        return 1;
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socketPath);
+    struct stat st;
+    if (lstat(socketPath, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) { // Only remove the socket of an earlier server, never a file
+            cerr << "Error: " << socketPath << " exists and is not a socket" << endl;
+            return 1;
+        }
+        unlink(socketPath);
+    }
+    if (server < 0 || bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(server, 16) < 0) {
+        perror("Error creating the socket");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN); // A client that disconnects early must not kill the server
+    cout << "Serving " << runs.size() << " runs on " << socketPath << endl;
+
+    bool stop = false;
+    while (!stop) {
+        int client = accept(server, 0, 0);
+        if (client < 0) continue;
+
+        timeval timeout = {kClientTimeout, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        // Request line, read in chunks up to the newline; EOF also ends it
+        string line;
+        bool complete = false;
+        char buffer[512];
+        while (line.size() <= kMaxRequestLine) {
+            ssize_t n = read(client, buffer, sizeof(buffer));
+            if (n <= 0) {
+                complete = (n == 0);
+                break;
+            }
+            line.append(buffer, n);
+            size_t newline = line.find('\n');
+            if (newline != string::npos) {
+                line.resize(newline);
+                complete = true;
+                break;
+            }
+        }
+
+        string reply;
+        if (line.size() > kMaxRequestLine) reply = "ERROR request longer than " + to_string(kMaxRequestLine) + " bytes\n";
+        else if (!complete) reply = "ERROR request not received within " + to_string(kClientTimeout) + " s\n";
+        else reply = answer(line, runs, stop);
+        for (size_t sent = 0; sent < reply.size();) {
+            ssize_t n = write(client, reply.data() + sent, reply.size() - sent);
+            if (n <= 0) break;
+            sent += n;
+        }
+        close(client);
+    }
+
+    close(server);
+    unlink(socketPath);
+    return 0;
+}
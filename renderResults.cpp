@@ -0,0 +1,236 @@
+//This code draws the canvases of an analysis results file, so layout changes never rerun the event loop or the fits.
+//The analyses (SinglePEfitGaussian.cpp, singepeGaussianFitxaxisADC, HistBaselineWITHCUT.cpp) only fill and fit histograms and
+//write them to a results file together with the kind of result ("resultKind") and the pad layout of the combined canvas.
+//Every individual plot and the combined canvas is a separate job; the jobs are shared between forked worker processes,
+//each of which opens the results file on its own and draws in batch mode.
+#include <iostream>
+#include <TFile.h>
+#include <TH1F.h>
+#include <TF1.h>
+#include <TCanvas.h>
+#include <TPaveStats.h>
+#include <TLatex.h>
+#include <TParameter.h>
+#include <TVectorD.h>
+#include <TSystem.h>
+#include <TStyle.h>
+#include <TROOT.h>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <unistd.h>   // For fork
+#include <sys/wait.h> // For waitpid
+
+using namespace std;
+
+// Everything the jobs need to know about a results file
+struct ResultsInfo {
+    string kind;          // "spe" or "baselineRMS"
+    int rows = 0, cols = 0;
+    vector<int> layout;   // rows*cols histogram indices, -1 for empty pads
+    vector<int> indices;  // Histogram indices with an individual plot
+};
+
+// Name of the histogram with the given index, and of its optional overlay
+TString histName(const string &kind, int idx) {
+    if (kind == "spe") return Form("PMT%d_Area", idx + 1);
+    return Form("hist_baselineRMS_ch%d", idx);
+}
+
+TString overlayName(const string &kind, int idx) {
+    if (kind == "baselineRMS") return Form("hist_baselineRMS_cut_ch%d", idx);
+    return "";
+}
+
+bool readResultsInfo(const char *resultsName, ResultsInfo &info) {
+    TFile *file = TFile::Open(resultsName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening results file: " << resultsName << endl;
+        return false;
+    }
+    TNamed *kind = (TNamed*)file->Get("resultKind");
+    auto rows = (TParameter<Int_t> *) file->Get("layoutRows");
+    auto cols = (TParameter<Int_t> *) file->Get("layoutCols");
+    TVectorD *layout = (TVectorD*)file->Get("layout");
+    if (!kind || !rows || !cols || !layout) {
+        cerr << "Error: " << resultsName << " is not an analysis results file" << endl;
+        file->Close();
+        return false;
+    }
+    info.kind = kind->GetTitle();
+    info.rows = rows->GetVal();
+    info.cols = cols->GetVal();
+    for (int i = 0; i < layout->GetNrows(); i++) {
+        int idx = (int)(*layout)[i];
+        info.layout.push_back(idx);
+        if (idx >= 0) info.indices.push_back(idx);
+    }
+    file->Close();
+    delete file;
+    return true;
+}
+
+// Move and restyle the stats box of a histogram with a stored fit
+void styleStats(TH1 *hist, double x1, double y1, double textSize) {
+    gPad->Update();
+    if (auto stats = (TPaveStats*)hist->FindObject("stats")) {
+        stats->SetX1NDC(x1); stats->SetY1NDC(y1);
+        stats->SetX2NDC(0.95); stats->SetY2NDC(0.95);
+        stats->SetTextFont(42);
+        stats->SetTextSize(textSize);
+        stats->SetOptStat(10);
+        stats->SetOptFit(111);
+        stats->SetName("");
+    }
+}
+
+// Draw one histogram (with its stored fit or overlay) in the current pad
+void drawHist(TFile *file, const ResultsInfo &info, int idx, bool combined) {
+    TH1 *hist = (TH1*)file->Get(histName(info.kind, idx));
+    if (!hist) {
+        cerr << "Missing histogram " << histName(info.kind, idx) << endl;
+        return;
+    }
+
+    TLatex tex;
+    tex.SetTextFont(42);
+    tex.SetTextAlign(22);
+    tex.SetNDC();
+
+    if (info.kind == "spe") {
+        hist->SetLineColor(kRed);
+        hist->GetXaxis()->SetTitleSize(combined ? 0.07 : 0.05);
+        hist->GetYaxis()->SetTitleSize(combined ? 0.09 : 0.05);
+        hist->GetXaxis()->SetLabelSize(0.04);
+        hist->GetYaxis()->SetLabelSize(0.04);
+        if (combined) hist->GetYaxis()->SetTitleOffset(0.8);
+        hist->Draw(); // The stored fit function is drawn with the histogram
+        tex.SetTextSize(combined ? 0.14 : 0.06);
+        tex.DrawLatex(0.5, 0.92, Form("PMT %d", idx + 1));
+        styleStats(hist, 0.65, 0.65, 0.03);
+    } else {
+        hist->GetXaxis()->SetTitle("Baseline RMS");
+        hist->GetYaxis()->SetTitle("Counts");
+        hist->Draw("hist");
+        TH1 *overlay = (TH1*)file->Get(overlayName(info.kind, idx));
+        if (overlay) {
+            overlay->SetLineColor(kRed);
+            overlay->Draw("hist same");
+        }
+    }
+}
+
+// Job 0 is the combined canvas, job i > 0 the individual plot of info.indices[i-1]
+void renderJob(const char *resultsName, const ResultsInfo &info, int job, const char *outputDir) {
+    TFile *file = TFile::Open(resultsName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening results file: " << resultsName << endl;
+        return;
+    }
+
+    gStyle->SetTextFont(42);
+    gStyle->SetLabelFont(42, "XYZ");
+    gStyle->SetTitleFont(42, "XYZ");
+    gStyle->SetTitleFontSize(0.11);
+
+    if (job == 0) {
+        bool spe = (info.kind == "spe");
+        if (spe) gStyle->SetImageScaling(2.0); // High-resolution PNG next to the vector PDF
+        TCanvas *master = new TCanvas("MasterCanvas", "Combined canvas", spe ? 2400 : 3600, spe ? 1600 : 3000);
+        if (spe) master->Divide(info.cols, info.rows, 0, 0);
+        else master->Divide(info.cols, info.rows);
+
+        for (int pad = 0; pad < info.rows * info.cols; pad++) {
+            int idx = info.layout[pad];
+            if (idx < 0) continue;
+            master->cd(pad + 1);
+            if (spe) {
+                gPad->SetLeftMargin(0.15);
+                gPad->SetRightMargin(0.12);
+                gPad->SetBottomMargin(0.15);
+                gPad->SetTopMargin(0.10);
+            }
+            drawHist(file, info, idx, true);
+        }
+
+        if (spe) {
+            master->SaveAs(Form("%s/Combined_PMT_Energy_Distributions.pdf", outputDir));
+            master->SaveAs(Form("%s/Combined_PMT_Energy_Distributions.png", outputDir));
+        } else {
+            master->cd(0);
+            TLatex textbox;
+            textbox.SetTextSize(0.02);
+            textbox.SetTextAlign(13);
+            textbox.SetNDC(true);
+            textbox.DrawLatex(0.01, 0.10, "X axis: BaselineRMS");
+            textbox.DrawLatex(0.01, 0.08, "Y axis: Counts");
+            master->SaveAs(Form("%s/combined_baselineRMS_histograms.png", outputDir));
+        }
+        delete master;
+    } else {
+        int idx = info.indices[job - 1];
+        TCanvas *canvas = new TCanvas(Form("Canvas_%d", idx), "Individual plot", 800, 600);
+        if (info.kind == "spe") {
+            canvas->SetLeftMargin(0.15);
+            canvas->SetRightMargin(0.05);
+            canvas->SetBottomMargin(0.15);
+            canvas->SetTopMargin(0.05);
+        }
+        drawHist(file, info, idx, false);
+        if (info.kind == "spe") canvas->SaveAs(Form("%s/PMT%d_Energy_Distribution.png", outputDir, idx + 1));
+        else canvas->SaveAs(Form("%s/channel_%d_histogram.png", outputDir, idx));
+        delete canvas;
+    }
+
+    file->Close();
+    delete file;
+}
+
+void renderResults(const char *resultsName, const char *outputDir, int nWorkers) {
+    ResultsInfo info;
+    if (!readResultsInfo(resultsName, info)) return;
+    gSystem->mkdir(outputDir, kTRUE);
+
+    int nJobs = info.indices.size() + 1;
+    if (nWorkers > nJobs) nWorkers = nJobs;
+    cout << "Rendering " << nJobs << " canvases of " << resultsName << " with " << nWorkers << " workers" << endl;
+
+    // Worker w draws jobs w, w + nWorkers, ...
+    vector<pid_t> workers;
+    for (int w = 0; w < nWorkers; w++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            cerr << "Error: fork failed, rendering the remaining jobs in this process" << endl;
+            for (int job = w; job < nJobs; job += nWorkers) renderJob(resultsName, info, job, outputDir);
+            continue;
+        }
+        if (pid == 0) {
+            for (int job = w; job < nJobs; job += nWorkers) renderJob(resultsName, info, job, outputDir);
+            _exit(0);
+        }
+        workers.push_back(pid);
+    }
+
+    int nFailed = 0;
+    for (size_t w = 0; w < workers.size(); w++) {
+        int status = 0;
+        waitpid(workers[w], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) nFailed++;
+    }
+    if (nFailed > 0) cerr << nFailed << " render workers failed" << endl;
+    else cout << "Plots saved under '" << outputDir << "/'." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 4) {
+        cerr << "Usage: " << argv[0] << " <results.root> [output_dir] [n_workers]" << endl;
+        return 1;
+    }
+    const char *outputDir = (argc >= 3) ? argv[2] : "plots";
+    int nWorkers = (argc >= 4) ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nWorkers < 1) nWorkers = 1;
+
+    gROOT->SetBatch(kTRUE);
+    renderResults(argv[1], outputDir, nWorkers);
+    return 0;
+}
@@ -0,0 +1,211 @@
+//This code builds a catalog of the run files in a processed-data directory (e.g. /data13/coherent/data/d2o/processedData/).
+//Files are scanned in parallel, one worker thread per core, and for every run it records the run number, starttime, number of entries,
+//the number of events with each triggerBits bit set, the nsTime span, the file size, the compressed and uncompressed tree sizes
+//and the MD5 checksum of the file. Only the triggerBits and nsTime branches are read.
+//The catalog is the TTree "catalog" in run_catalog.root and can be queried without opening any run file, e.g.
+//    ./runCatalog --query "entries>1000000" run_catalog.root
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TParameter.h>
+#include <TSystem.h>
+#include <TMD5.h>
+#include <TROOT.h>
+#include "RunFileIO.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+
+using namespace std;
+
+// Everything the catalog records about one run file
+struct RunInfo {
+    string path;
+    Int_t run = -1;
+    Long64_t starttime = -1;
+    Long64_t entries = 0;
+    Long64_t triggerCounts[32] = {0}; // Events with triggerBits bit b set
+    Long64_t nsTimeFirst = 0, nsTimeLast = 0;
+    Long64_t fileSize = 0, zipBytes = 0, totBytes = 0;
+    string checksum;
+    bool ok = false;
+};
+
+// Read the metadata of one run file
+void scanRun(RunInfo &info, bool computeChecksum) {
+    TFile *file = TFile::Open(info.path.c_str());
+    if (!file || file->IsZombie()) {
+        cerr << "Error: Could not open ROOT file: " << info.path << endl;
+        delete file;
+        return;
+    }
+
+    sscanf(gSystem->BaseName(info.path.c_str()), "run%d", &info.run);
+    info.fileSize = file->GetSize();
+
+    auto tsstart = (TParameter<Long64_t> *) file->Get("starttime");
+    if (tsstart) info.starttime = tsstart->GetVal();
+
+    TTree *tree = (TTree*)file->Get("tree");
+    if (tree) {
+        Int_t triggerBits;
+        Long64_t nsTime;
+        tree->SetBranchStatus("*", 0);
+        tree->SetBranchStatus("triggerBits", 1);
+        tree->SetBranchStatus("nsTime", 1);
+        tree->SetBranchAddress("triggerBits", &triggerBits);
+        tree->SetBranchAddress("nsTime", &nsTime);
+        CacheActiveBranches(tree);
+
+        info.entries = tree->GetEntries();
+        info.zipBytes = tree->GetZipBytes();
+        info.totBytes = tree->GetTotBytes();
+        info.nsTimeFirst = LLONG_MAX;
+        info.nsTimeLast = LLONG_MIN;
+        for (Long64_t entry = 0; entry < info.entries; entry++) {
+            tree->GetEntry(entry);
+            for (int b = 0; b < 32; b++) {
+                if (triggerBits & (1u << b)) info.triggerCounts[b]++;
+            }
+            info.nsTimeFirst = min(info.nsTimeFirst, nsTime);
+            info.nsTimeLast = max(info.nsTimeLast, nsTime);
+        }
+        if (info.entries == 0) info.nsTimeFirst = info.nsTimeLast = 0;
+    } else {
+        cerr << "Error: 'tree' not found in " << info.path << endl;
+    }
+    file->Close();
+    delete file;
+
+    if (computeChecksum) {
+        TMD5 *md5 = TMD5::FileChecksum(info.path.c_str());
+        if (md5) info.checksum = md5->AsString();
+        delete md5;
+    }
+    info.ok = true;
+}
+
+void buildCatalog(const char *dirName, const char *catalogName, int nWorkers, bool computeChecksum) {
+    // Collect the run files of the directory
+    vector<RunInfo> runs;
+    void *dir = gSystem->OpenDirectory(dirName);
+    if (!dir) {
+        cerr << "Error: Cannot open directory " << dirName << endl;
+        return;
+    }
+    while (const char *entry = gSystem->GetDirEntry(dir)) {
+        string name = entry;
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, ".root") == 0) {
+            RunInfo info;
+            info.path = string(dirName) + "/" + name;
+            runs.push_back(info);
+        }
+    }
+    gSystem->FreeDirectory(dir);
+    if (runs.empty()) {
+        cerr << "No .root files found in " << dirName << endl;
+        return;
+    }
+
+    // Scan the files in parallel; each worker takes the next unscanned file
+    ROOT::EnableThreadSafety();
+    if (nWorkers > (int)runs.size()) nWorkers = runs.size();
+    cout << "Scanning " << runs.size() << " files with " << nWorkers << " workers..." << endl;
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (int w = 0; w < nWorkers; w++) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < runs.size(); i = next++) scanRun(runs[i], computeChecksum);
+        });
+    }
+    for (auto &worker : workers) worker.join();
+
+    sort(runs.begin(), runs.end(), [](const RunInfo &a, const RunInfo &b) {
+        return a.run != b.run ? a.run < b.run : a.path < b.path;
+    });
+
+    // Write the catalog tree
+    TFile *catalogFile = new TFile(catalogName, "RECREATE");
+    if (!catalogFile || catalogFile->IsZombie()) {
+        cerr << "Error creating catalog file!" << endl;
+        return;
+    }
+
+    Char_t path[1024], checksum[64];
+    RunInfo row;
+    TTree *catalog = new TTree("catalog", "Run catalog");
+    catalog->Branch("path", path, "path/C");
+    catalog->Branch("run", &row.run, "run/I");
+    catalog->Branch("starttime", &row.starttime, "starttime/L");
+    catalog->Branch("entries", &row.entries, "entries/L");
+    catalog->Branch("triggerCounts", row.triggerCounts, "triggerCounts[32]/L");
+    catalog->Branch("nsTimeFirst", &row.nsTimeFirst, "nsTimeFirst/L");
+    catalog->Branch("nsTimeLast", &row.nsTimeLast, "nsTimeLast/L");
+    catalog->Branch("fileSize", &row.fileSize, "fileSize/L");
+    catalog->Branch("zipBytes", &row.zipBytes, "zipBytes/L");
+    catalog->Branch("totBytes", &row.totBytes, "totBytes/L");
+    catalog->Branch("checksum", checksum, "checksum/C");
+
+    Long64_t totalEntries = 0;
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (!runs[i].ok) continue;
+        row = runs[i];
+        snprintf(path, sizeof(path), "%s", row.path.c_str());
+        snprintf(checksum, sizeof(checksum), "%s", row.checksum.c_str());
+        catalog->Fill();
+        totalEntries += row.entries;
+    }
+    catalog->Write();
+    catalogFile->Close();
+    delete catalogFile;
+
+    cout << "Catalog of " << runs.size() << " runs (" << totalEntries << " entries) written to " << catalogName << endl;
+}
+
+// Print the catalog rows passing a TTree selection
+void queryCatalog(const char *catalogName, const char *selection) {
+    TFile *catalogFile = TFile::Open(catalogName);
+    if (!catalogFile || catalogFile->IsZombie()) {
+        cerr << "Error opening catalog file: " << catalogName << endl;
+        return;
+    }
+    TTree *catalog = (TTree*)catalogFile->Get("catalog");
+    if (!catalog) {
+        cerr << "Error: 'catalog' not found in " << catalogName << endl;
+        catalogFile->Close();
+        return;
+    }
+    catalog->Scan("run:starttime:entries:triggerCounts[1]:triggerCounts[4]:fileSize", selection);
+    catalogFile->Close();
+    delete catalogFile;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc >= 3 && strcmp(argv[1], "--query") == 0) {
+        queryCatalog(argc >= 4 ? argv[3] : "run_catalog.root", argv[2]);
+        return 0;
+    }
+
+    bool computeChecksum = true;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-checksum") == 0) computeChecksum = false;
+        else args.push_back(argv[i]);
+    }
+    if (args.empty() || args.size() > 3) {
+        cerr << "Usage: " << argv[0] << " <data_dir> [catalog.root] [n_workers] [--no-checksum]" << endl;
+        cerr << "       " << argv[0] << " --query \"<selection>\" [catalog.root]" << endl;
+        return 1;
+    }
+
+    const char *catalogName = (args.size() >= 2) ? args[1] : "run_catalog.root";
+    int nWorkers = (args.size() >= 3) ? atoi(args[2]) : (int)thread::hardware_concurrency();
+    if (nWorkers < 1) nWorkers = 1;
+    buildCatalog(args[0], catalogName, nWorkers, computeChecksum);
+    return 0;
+}
@@ -1,9 +1,13 @@
 //The program calculates the time difference for all events but prints values only for the first 10 events.
 //It generates a histogram of the time difference distribution and saves it as an image file.
+//The event loop is checkpointed every checkpointInterval events; pass --resume to continue from the last checkpoint. The checkpoint
+//records the input file and entry range, and --resume stops with an error on a checkpoint of another file or range.
+//The histogram and the time differences (tree deltaT) are saved in time_difference.root (--output to change it).
+//With --entries begin:end only the muons of those entries are processed; the Michel search continues past the end of the range
+//until the 10 μs window closes, so shards of a run (makeShardManifest) together find every pair exactly once.
 #include <iostream>
 #include <TFile.h>
 #include <TTree.h>
-#include <TGraph.h>
 #include <TCanvas.h>
 #include <TAxis.h>
 #include <TH1F.h>
@@ -11,27 +15,91 @@
 #include <algorithm>
 #include <cmath>
 #include "TLatex.h"
+#include "RunFileIO.h"
+#include "DetectorGeometry.h"
+#include <TVectorD.h>
+#include <TParameter.h>
+#include <TSystem.h>
 #include <sys/stat.h> // For mkdir
 
 using namespace std;
 
-// Function to find the time of the peak in a waveform
-double findPeakTime(TGraph* graph) {
+// Checkpoint of the event loop so a failed job can resume where it stopped
+TString checkpointFileName = "time_difference.checkpoint.root";
+const Long64_t checkpointInterval = 100000; // Events between two checkpoints
+
+// Save the input of the job, the next event to process, the histogram and the time differences found so far.
+// Written under a temporary name and renamed, so the previous checkpoint survives a crash.
+void writeCheckpoint(const JobIdentity &job, Long64_t nextEventID, TH1F *timeDiffHist, const vector<double> &timeDifferences) {
+    TString tmpName = TString(checkpointFileName) + ".tmp";
+    TDirectory *savedDir = gDirectory;
+    TFile *checkpoint = new TFile(tmpName, "RECREATE");
+    if (!checkpoint || checkpoint->IsZombie()) {
+        cerr << "Error creating checkpoint file!" << endl;
+        delete checkpoint;
+        savedDir->cd();
+        return;
+    }
+    WriteJobIdentity(job);
+    TParameter<Long64_t>("nextEventID", nextEventID).Write();
+    timeDiffHist->Write();
+    TVectorD(timeDifferences.size(), timeDifferences.data()).Write("timeDifferences");
+    checkpoint->Close();
+    delete checkpoint;
+    gSystem->Rename(tmpName, checkpointFileName);
+    savedDir->cd();
+}
+
+// Restore the loop state. Returns the event to continue from, 0 if there is no checkpoint, or -1 if the checkpoint belongs
+// to another input file or entry range.
+Long64_t readCheckpoint(const JobIdentity &job, TH1F *timeDiffHist, vector<double> &timeDifferences) {
+    TDirectory *savedDir = gDirectory;
+    TFile *checkpoint = TFile::Open(checkpointFileName);
+    if (!checkpoint || checkpoint->IsZombie()) {
+        delete checkpoint;
+        savedDir->cd();
+        return 0;
+    }
+    if (!CheckJobIdentity(checkpoint, job)) {
+        checkpoint->Close();
+        delete checkpoint;
+        savedDir->cd();
+        return -1;
+    }
+    Long64_t nextEventID = 0;
+    auto nextPar = (TParameter<Long64_t> *) checkpoint->Get("nextEventID");
+    TH1F *savedHist = (TH1F*)checkpoint->Get("timeDiffHist");
+    TVectorD *savedDiffs = (TVectorD*)checkpoint->Get("timeDifferences");
+    if (nextPar && savedHist && savedDiffs) {
+        nextEventID = nextPar->GetVal();
+        timeDiffHist->Reset();
+        timeDiffHist->Add(savedHist);
+        timeDifferences.assign(savedDiffs->GetMatrixArray(), savedDiffs->GetMatrixArray() + savedDiffs->GetNrows());
+    } else {
+        cerr << "Error: incomplete checkpoint file " << checkpointFileName << endl;
+    }
+    checkpoint->Close();
+    delete checkpoint;
+    savedDir->cd();
+    return nextEventID;
+}
+
+// Function to find the time of the peak in a waveform; sample k is at (k + 1) x 16 ns
+double findPeakTime(const Short_t *samples) {
     double maxADC = -1;
     double peakTime = -1;
-    double x, y;
 
-    for (int i = 0; i < graph->GetN(); i++) {
-        graph->GetPoint(i, x, y);
-        if (y > maxADC) {
-            maxADC = y;
-            peakTime = x;
+    for (int k = 0; k < 45; k++) {
+        if (samples[k] > maxADC) {
+            maxADC = samples[k];
+            peakTime = (k + 1) * 16.0;
         }
     }
     return peakTime;
 }
 
-void analyzeMuonDecay(const char *fileName, Long64_t maxEvents = -1) {
+void analyzeMuonDecay(const char *fileName, Long64_t maxEvents = -1, bool resume = false,
+                      EntryRange range = EntryRange(), const char *outputName = "time_difference.root") {
     TFile *file = TFile::Open(fileName);
     if (!file || file->IsZombie()) {
         cerr << "Error opening file: " << fileName << endl;
@@ -49,19 +117,21 @@ void analyzeMuonDecay(const char *fileName, Long64_t maxEvents = -1) {
     Long64_t nsTime; // Event time in nanoseconds from the start of the run
     tree->SetBranchAddress("adcVal", adcVal);
     tree->SetBranchAddress("nsTime", &nsTime); // Add nsTime branch
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("adcVal", 1);
+    tree->SetBranchStatus("nsTime", 1);
+    CacheActiveBranches(tree);
 
     Long64_t nEntries = tree->GetEntries();
     cout << "Total events in the file: " << nEntries << endl;
 
-    // If maxEvents is not specified or is larger than the total number of events, process all events
-    if (maxEvents < 0 || maxEvents > nEntries) {
-        maxEvents = nEntries;
+    // maxEvents limits the range; if it is not specified or is larger than the total number of events, process all events
+    if (maxEvents >= 0 && (range.end < 0 || range.end > maxEvents)) {
+        range.end = maxEvents;
     }
-    cout << "Processing " << maxEvents << " events..." << endl;
-
-    // Declare PMT and SiPM channel maps
-    int pmtChannelMap[12] = {0, 10, 7, 2, 6, 3, 8, 9, 11, 4, 5, 1}; // PMTs inside the detector
-    int sipmChannelMap[10] = {12, 13, 14, 15, 16, 17, 18, 19, 20, 21}; // SiPMs in the veto system
+    ClampEntryRange(range, nEntries);
+    tree->SetCacheEntryRange(range.begin, nEntries);
+    cout << "Processing events " << range.begin << " to " << range.end - 1 << "..." << endl;
 
     // Threshold for muon detection (adjust as needed)
     double muonThreshold = 1000; // Example threshold in ADC counts
@@ -72,8 +142,27 @@ void analyzeMuonDecay(const char *fileName, Long64_t maxEvents = -1) {
     // Histogram for time difference distribution
     TH1F *timeDiffHist = new TH1F("timeDiffHist", "Time Difference (Michel - Muon); Time Difference [ns]; Counts", 100, 0, 10000);
 
+    // Continue from the last checkpoint if requested
+    JobIdentity job = MakeJobIdentity(fileName, range);
+    Long64_t firstEventID = range.begin;
+    if (resume) {
+        Long64_t nextEventID = readCheckpoint(job, timeDiffHist, timeDifferences);
+        if (nextEventID < 0) {
+            cerr << "Error: " << checkpointFileName << " was not written by this job; remove it or rerun without --resume" << endl;
+            delete timeDiffHist;
+            file->Close();
+            delete file;
+            return;
+        }
+        if (nextEventID > 0) firstEventID = nextEventID;
+        cout << "Resuming at event " << firstEventID << " with " << timeDifferences.size() << " time differences" << endl;
+    }
+
     // Loop through the specified number of events
-    for (Long64_t EventID = 0; EventID < maxEvents; EventID++) {
+    for (Long64_t EventID = firstEventID; EventID < range.end; EventID++) {
+        if (EventID > firstEventID && EventID % checkpointInterval == 0) {
+            writeCheckpoint(job, EventID, timeDiffHist, timeDifferences);
+        }
         tree->GetEntry(EventID); // Load the current event
 
         // Variables to store peak times
@@ -81,39 +170,14 @@ void analyzeMuonDecay(const char *fileName, Long64_t maxEvents = -1) {
         double michelPeakTime = -1;
 
         // Analyze SiPMs (veto system) and PMTs for muon signal
-        for (int i = 0; i < 10; i++) { // Loop over SiPMs
-            TGraph *sipmGraph = new TGraph();
-            int adcIndex = sipmChannelMap[i];
-
-            for (int k = 0; k < 45; k++) {
-                double time = (k + 1) * 16.0; // Time of the sample in the waveform
-                double adcValue = adcVal[adcIndex][k];
-                sipmGraph->SetPoint(k, time, adcValue);
-            }
-
-            double peakTime = findPeakTime(sipmGraph);
+        auto updateMuonPeakTime = [&](int p) {
+            double peakTime = findPeakTime(adcVal[HardwareChannel(p)]);
             if (peakTime > muonPeakTime) {
                 muonPeakTime = peakTime; // Update muon peak time
             }
-            delete sipmGraph;
-        }
-
-        for (int i = 0; i < 12; i++) { // Loop over PMTs
-            TGraph *pmtGraph = new TGraph();
-            int adcIndex = pmtChannelMap[i];
-
-            for (int k = 0; k < 45; k++) {
-                double time = (k + 1) * 16.0; // Time of the sample in the waveform
-                double adcValue = adcVal[adcIndex][k];
-                pmtGraph->SetPoint(k, time, adcValue);
-            }
-
-            double peakTime = findPeakTime(pmtGraph);
-            if (peakTime > muonPeakTime) {
-                muonPeakTime = peakTime; // Update muon peak time
-            }
-            delete pmtGraph;
-        }
+        };
+        ForEachChannel<kSiPMChannel>(updateMuonPeakTime);
+        ForEachChannel<kPMTChannel>(updateMuonPeakTime);
 
         // Check if a muon candidate is found
         if (muonPeakTime != -1) {
@@ -124,22 +188,14 @@ void analyzeMuonDecay(const char *fileName, Long64_t maxEvents = -1) {
             double michelWindowStart = muonAbsoluteTime;
             double michelWindowEnd = muonAbsoluteTime + 10000; // 10 μs window
 
-            // Loop through subsequent events to find Michel electron
-            for (Long64_t nextEventID = EventID + 1; nextEventID < maxEvents; nextEventID++) {
+            // Loop through subsequent events to find Michel electron, also past the end of the range (shard overlap)
+            for (Long64_t nextEventID = EventID + 1; nextEventID < nEntries; nextEventID++) {
                 tree->GetEntry(nextEventID); // Load the next event
+                if (nsTime > michelWindowEnd) break; // Events are time ordered: the window is closed
 
                 // Analyze PMTs for Michel electron signal
-                for (int i = 0; i < 12; i++) { // Loop over PMTs
-                    TGraph *pmtGraph = new TGraph();
-                    int adcIndex = pmtChannelMap[i];
-
-                    for (int k = 0; k < 45; k++) {
-                        double time = (k + 1) * 16.0; // Time of the sample in the waveform
-                        double adcValue = adcVal[adcIndex][k];
-                        pmtGraph->SetPoint(k, time, adcValue);
-                    }
-
-                    double peakTime = findPeakTime(pmtGraph);
+                for (int p = 0; p < kNumPMTs; p++) { // Loop over PMTs in physical order; the first in the window is taken
+                    double peakTime = findPeakTime(adcVal[HardwareChannel(p)]);
                     double michelAbsoluteTime = nsTime + peakTime;
 
                     // Check if the Michel electron signal is within the 10 μs window
@@ -147,7 +203,6 @@ void analyzeMuonDecay(const char *fileName, Long64_t maxEvents = -1) {
                         michelPeakTime = peakTime; // Update Michel electron peak time
                         break;
                     }
-                    delete pmtGraph;
                 }
 
                 if (michelPeakTime != -1) {
@@ -178,25 +233,72 @@ void analyzeMuonDecay(const char *fileName, Long64_t maxEvents = -1) {
     TCanvas *canvas = new TCanvas("canvas", "Time Difference Distribution", 800, 600);
     timeDiffHist->Draw();
     canvas->SaveAs("time_difference_distribution.png");
+    delete canvas;
+
+    // Save the histogram and the time differences; shards are combined with mergeShards
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+    } else {
+        Double_t timeDifference;
+        TTree *deltaTTree = new TTree("deltaT", "Michel - muon time differences");
+        deltaTTree->Branch("timeDifference", &timeDifference, "timeDifference/D");
+        for (size_t i = 0; i < timeDifferences.size(); i++) {
+            timeDifference = timeDifferences[i];
+            deltaTTree->Fill();
+        }
+        deltaTTree->Write();
+        timeDiffHist->Write();
+        outputFile->Close();
+        cout << timeDifferences.size() << " time differences saved in " << outputName << endl;
+    }
+    delete outputFile;
+    delete timeDiffHist;
 
     file->Close();
+    delete file;
+
+    // The job finished, so the checkpoint is no longer needed
+    gSystem->Unlink(checkpointFileName);
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <root_file> [max_events]" << endl;
+    // The options may appear anywhere after the file name
+    bool resume = false;
+    EntryRange range;
+    const char *outputName = "time_difference.root";
+    vector<const char*> args;
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--resume") resume = true;
+        else if (arg == "--output" && i + 1 < argc) outputName = argv[++i];
+        else if (arg == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], range)) {
+                cerr << "Error: invalid entry range " << argv[i] << endl;
+                return 1;
+            }
+        }
+        else args.push_back(argv[i]);
+    }
+
+    if (args.size() < 2) {
+        cerr << "Usage: " << argv[0] << " <root_file> [max_events] [--entries begin:end] [--output file.root] [--resume]" << endl;
         return 1;
     }
 
-    const char* fileName = argv[1]; // First argument is the ROOT file name
+    // Shards running side by side need their own checkpoint
+    if (string(outputName) != "time_difference.root") checkpointFileName = TString(outputName) + ".checkpoint.root";
+
+    const char* fileName = args[1]; // First argument is the ROOT file name
 
     // Second argument is the maximum number of events to process (optional)
     Long64_t maxEvents = -1; // Default: process all events
-    if (argc >= 3) {
-        maxEvents = atoi(argv[2]); // Convert argument to integer
+    if (args.size() >= 3) {
+        maxEvents = atoi(args[2]); // Convert argument to integer
     }
 
-    analyzeMuonDecay(fileName, maxEvents); // Process events in the file
+    InitRunFileIO();
+    analyzeMuonDecay(fileName, maxEvents, resume, range, outputName); // Process events in the file
 
     return 0;
 }
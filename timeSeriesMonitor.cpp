@@ -0,0 +1,221 @@
+//This code monitors a run as a time series: one pass over the tree bins baselineMean, baselineRMS of all 23 channels and the rate of
+//every triggerBits bit in fixed nsTime intervals (1 s by default, --interval seconds), with one IntervalAccumulator per interval
+//(TimeSeriesAccumulator.h). Intervals are then flagged against the whole run: a channel whose mean baseline or baseline RMS, or a
+//trigger bit whose rate, is more than --nsigma (default 5) robust standard deviations (1.4826 x MAD over the intervals, at least the
+//statistical error of the interval) from the median of the run, and empty intervals inside the run. Intervals far outside the run
+//(more than the span of the central 98% of the times beyond it, estimated from a fixed-size sample of the times) hold corrupt
+//nsTime values; their events are skipped.
+//With --entries begin:end only those entries are read; the intervals lie on a grid starting at nsTime 0, so mergeShards merges the
+//outputs of the shards interval by interval and flags the merged intervals against the whole run.
+//Written to time_series.root (WriteTimeSeries):
+//  - tree "timeSeries", one entry per interval: the raw accumulator sums, flags (IntervalFlag bits) and badChannels (23-bit mask),
+//  - TEntryList "goodEntries" with the entries read in the unflagged intervals, so only the bad periods are dropped:
+//        TFile ts("time_series.root"); tree->SetEntryList((TEntryList*)ts.Get("goodEntries"));
+//and time_series_rates.png shows the event rate versus time with the flagged intervals in red.
+#include <iostream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TBranch.h>
+#include <TH1F.h>
+#include <TCanvas.h>
+#include <TEntryList.h>
+#include <TParameter.h>
+#include <TRandom3.h>
+#include "TimeSeriesAccumulator.h"
+#include "RunFileIO.h"
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+// Times kept to estimate the span of the run, and the most intervals a run may touch (about 0.7 GB of accumulators)
+const size_t kTimeSampleSize = 100000;
+const size_t kMaxIntervals = 1 << 19;
+
+void timeSeriesMonitor(const char *fileName, const char *outputName, EntryRange range, double intervalSeconds, double nSigma) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree 'tree'!" << endl;
+        file->Close();
+        return;
+    }
+
+    Double_t baselineMean[23], baselineRMS[23];
+    Int_t triggerBits;
+    Long64_t nsTime;
+    tree->SetBranchStatus("*", 0);
+    tree->SetBranchStatus("baselineMean", 1);
+    tree->SetBranchStatus("baselineRMS", 1);
+    tree->SetBranchStatus("triggerBits", 1);
+    tree->SetBranchStatus("nsTime", 1);
+    tree->SetBranchAddress("baselineMean", baselineMean);
+    tree->SetBranchAddress("baselineRMS", baselineRMS);
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+    tree->SetBranchAddress("nsTime", &nsTime);
+    CacheActiveBranches(tree);
+
+    Long64_t nEntries = tree->GetEntries();
+    ClampEntryRange(range, nEntries);
+    tree->SetCacheEntryRange(range.begin, range.end);
+
+    // Single pass: every event goes to the accumulator of its interval, created with the first event of the interval. A corrupt
+    // nsTime makes an interval of its own, dropped after the pass; kMaxIntervals bounds the memory if nsTime is garbage.
+    // The span of the run comes from a uniform sample of kTimeSampleSize times (reservoir sampling; all of them in a short run).
+    TimeSeries series;
+    series.intervalSeconds = intervalSeconds;
+    struct Interval {
+        IntervalAccumulator acc;
+        Long64_t tMin, tMax;
+    };
+    map<Long64_t, Interval> intervals;
+    vector<Long64_t> timeSample;
+    TRandom3 random(1);
+    Long64_t nRead = 0;
+    for (Long64_t entry = range.begin; entry < range.end; entry++) {
+        tree->GetEntry(entry);
+        if (timeSample.size() < kTimeSampleSize) {
+            timeSample.push_back(nsTime);
+        } else {
+            Long64_t slot = (Long64_t)(random.Rndm() * (nRead + 1));
+            if (slot < (Long64_t)kTimeSampleSize) timeSample[slot] = nsTime;
+        }
+        nRead++;
+
+        Long64_t index = series.IndexOf(nsTime);
+        Interval &interval = intervals[index];
+        if (interval.acc.nEvents == 0) interval.tMin = interval.tMax = nsTime;
+        interval.tMin = min(interval.tMin, nsTime);
+        interval.tMax = max(interval.tMax, nsTime);
+        interval.acc.Fill(entry, triggerBits, baselineMean, baselineRMS);
+        if (!series.segments.empty() && series.segments.back().interval == index && series.segments.back().last == entry - 1) {
+            series.segments.back().last = entry;
+        } else {
+            EntrySegment segment = {entry, entry, index};
+            series.segments.push_back(segment);
+        }
+        if (intervals.size() > kMaxIntervals) {
+            cerr << "Error: nsTime spreads over more than " << kMaxIntervals << " intervals of " << intervalSeconds
+                 << " s; the times are corrupt or the interval is too short" << endl;
+            file->Close();
+            return;
+        }
+    }
+    if (nRead == 0) {
+        cerr << "No events in " << fileName << endl;
+        file->Close();
+        return;
+    }
+
+    // Span of the run without corrupt times: the central 98% of the sampled times, widened by its own length on both sides
+    sort(timeSample.begin(), timeSample.end());
+    size_t nSample = timeSample.size();
+    Long64_t tLow = timeSample[nSample / 100], tHigh = timeSample[nSample - 1 - nSample / 100];
+    Long64_t margin = tHigh - tLow;
+    Long64_t indexLow = series.IndexOf(tLow - margin), indexHigh = series.IndexOf(tHigh + margin);
+    Long64_t nRejected = 0;
+    for (map<Long64_t, Interval>::iterator it = intervals.begin(); it != intervals.end();) {
+        if (it->first < indexLow || it->first > indexHigh) {
+            nRejected += it->second.acc.nEvents;
+            intervals.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    if (nRejected > 0) cerr << "Warning: " << nRejected << " events with nsTime outside the run span were skipped" << endl;
+    Long64_t firstIndex = intervals.begin()->first, lastIndex = intervals.rbegin()->first;
+    if (lastIndex - firstIndex >= (Long64_t)kMaxIntervals) {
+        cerr << "Error: the run spans more than " << kMaxIntervals << " intervals of " << intervalSeconds << " s" << endl;
+        file->Close();
+        return;
+    }
+    series.firstInterval = firstIndex;
+    series.intervals.resize(lastIndex - firstIndex + 1);
+    series.nsTimeFirst = intervals.begin()->second.tMin;
+    series.nsTimeLast = intervals.begin()->second.tMax;
+    for (map<Long64_t, Interval>::iterator it = intervals.begin(); it != intervals.end(); ++it) {
+        series.intervals[it->first - firstIndex] = it->second.acc;
+        series.nsTimeFirst = min(series.nsTimeFirst, it->second.tMin);
+        series.nsTimeLast = max(series.nsTimeLast, it->second.tMax);
+    }
+    map<Long64_t, Interval>().swap(intervals);
+    vector<EntrySegment> segments;
+    for (size_t s = 0; s < series.segments.size(); s++) {
+        if (series.segments[s].interval >= firstIndex && series.segments[s].interval <= lastIndex) segments.push_back(series.segments[s]);
+    }
+    series.segments.swap(segments);
+
+    vector<UInt_t> flags, badChannels;
+    FlagIntervals(series, nSigma, flags, badChannels);
+
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        file->Close();
+        return;
+    }
+    TEntryList *goodEntries = new TEntryList("goodEntries", "Entries of the unflagged intervals", tree);
+    Long64_t nGood = WriteTimeSeries(series, flags, badChannels, nSigma, goodEntries);
+    size_t nIntervals = series.intervals.size();
+    int nFlagged = 0;
+    for (size_t i = 0; i < nIntervals; i++) {
+        if (flags[i]) nFlagged++;
+    }
+    TH1F *rateHist = (TH1F*)outputFile->Get("eventRate");
+    TH1F *flaggedHist = (TH1F*)outputFile->Get("flaggedRate");
+
+    TCanvas *canvas = new TCanvas("canvas", "Event rate", 1200, 600);
+    rateHist->SetLineColor(kBlack);
+    rateHist->SetStats(0);
+    rateHist->Draw("HIST");
+    flaggedHist->SetFillColor(kRed);
+    flaggedHist->SetLineColor(kRed);
+    flaggedHist->Draw("HIST SAME");
+    canvas->SaveAs("time_series_rates.png");
+    delete canvas;
+
+    cout << nIntervals << " intervals of " << intervalSeconds << " s, " << nFlagged << " flagged; " << nGood << " of " << nRead
+         << " entries in good intervals" << endl;
+    cout << "Time series saved in " << outputName << endl;
+
+    outputFile->Close();
+    delete outputFile;
+    file->Close();
+    delete file;
+}
+
+int main(int argc, char* argv[]) {
+    double intervalSeconds = 1, nSigma = 5;
+    EntryRange range;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], range)) {
+                cerr << "Error: invalid entry range " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--interval" && i + 1 < argc) {
+            intervalSeconds = atof(argv[++i]);
+        } else if (arg == "--nsigma" && i + 1 < argc) {
+            nSigma = atof(argv[++i]);
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() < 1 || args.size() > 2 || intervalSeconds <= 0 || nSigma <= 0) {
+        cerr << "Usage: " << argv[0] << " <root_file> [time_series.root] [--interval seconds] [--nsigma N] [--entries begin:end]" << endl;
+        return 1;
+    }
+    InitRunFileIO();
+    timeSeriesMonitor(args[0], (args.size() == 2) ? args[1] : "time_series.root", range, intervalSeconds, nSigma);
+    return 0;
+}
@@ -0,0 +1,403 @@
+//This code re-triggers a recorded run in software: every entry is evaluated against a set of candidate trigger configurations, so
+//the events a new PMT multiplicity, threshold, coincidence window or SiPM veto would have selected are known before the hardware
+//is changed. A configuration is a comma-separated list of conditions (--trigger, repeatable, or one per line in --triggers FILE):
+//    mult=4,thr=30,window=4,veto=1000,name=pmt4_veto
+//  mult     PMTs above thr within a coincidence window (default 1; 0 = no PMT condition)
+//  thr      PMT threshold in ADC counts above baselineMean (default 20)
+//  window   coincidence window in samples of 16 ns (default 4); a PMT's time is its first sample above thr
+//  sipm     SiPMs above sipmthr required (default 0), sipmthr in raw ADC counts (default 1000, the muon threshold of classifyEvents)
+//  veto     reject the event if a SiPM is above veto (raw ADC counts; default none)
+//Without configurations a scan of mult 1-12 x thr 10, 20, 30, 50, 100 is run. With --source pulses the PMTs use pulseH above thr
+//at time peakPosition instead of the waveforms.
+//All configurations are evaluated in one pass: per event, the first-crossing times of the distinct thresholds and the
+//coincidence counts of the distinct windows are computed once, then every configuration is a table lookup in a branch-free loop.
+//Written to trigger_emulation.root:
+//  - friend tree "emulatedTrigger": word[(nConfigs+63)/64], bit c of the words = configuration c fired, one entry per entry,
+//  - tree "triggerConfigs", one entry per configuration: its conditions, the events it fires on per recorded triggerBits bit and
+//    the agreement with the recorded trigger: efficiency and purity. The reference is given as a triggerBits value with a single bit
+//    set, --reference-trigger V (default 2, the PMT trigger triggerBits == 2; 16 is the LED), or as its bit index, --reference-bit B
+//    (bit 1 = triggerBits 2).
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <TFile.h>
+#include <TTree.h>
+#include <TParameter.h>
+#include "RunFileIO.h"
+#include "WaveformCodec.h"
+#include "DetectorGeometry.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+struct TriggerConfig {
+    string name;
+    int mult = 1;
+    double thr = 20;
+    int window = 4;
+    int sipm = 0;
+    double sipmThr = 1000;
+    double veto = -1;
+};
+
+bool parseConfig(const string &spec, TriggerConfig &config) {
+    config = TriggerConfig();
+    config.name = spec;
+    stringstream tokens(spec);
+    string token;
+    while (getline(tokens, token, ',')) {
+        size_t eq = token.find('=');
+        if (eq == string::npos) return false;
+        string key = token.substr(0, eq), value = token.substr(eq + 1);
+        if (key == "name") config.name = value;
+        else if (key == "mult") config.mult = atoi(value.c_str());
+        else if (key == "thr") config.thr = atof(value.c_str());
+        else if (key == "window") config.window = atoi(value.c_str());
+        else if (key == "sipm") config.sipm = atoi(value.c_str());
+        else if (key == "sipmthr") config.sipmThr = atof(value.c_str());
+        else if (key == "veto") config.veto = atof(value.c_str());
+        else return false;
+    }
+    return config.mult >= 0 && config.mult <= kNumPMTs && config.window >= 1 && config.sipm >= 0 && config.sipm <= kNumSiPMs;
+}
+
+// Index of value in the list of distinct values, added if new
+template <class T>
+int distinctIndex(vector<T> &values, T value) {
+    typename vector<T>::iterator it = find(values.begin(), values.end(), value);
+    if (it != values.end()) return it - values.begin();
+    values.push_back(value);
+    return values.size() - 1;
+}
+
+// All configurations as tables of indices into the per-event quantities they share
+struct TriggerBank {
+    vector<double> pmtThresholds;    // Distinct PMT thresholds, ascending
+    vector<int> windows;             // Distinct coincidence windows
+    vector<double> sipmThresholds;   // Distinct SiPM thresholds (sipmthr and veto); one extra slot that is always 0
+    vector<int> mult, coincidenceIndex, sipm, sipmIndex, vetoIndex;
+
+    // Per-event quantities
+    vector<int> crossing;            // [threshold][PMT] first sample above the threshold, -1 if none
+    vector<int> coincidence;         // [threshold][window] most PMTs within the window
+    vector<int> sipmCount;           // [SiPM threshold] SiPMs above it
+    vector<unsigned char> fired;     // [configuration]
+
+    explicit TriggerBank(const vector<TriggerConfig> &configs) {
+        for (size_t c = 0; c < configs.size(); c++) {
+            distinctIndex(pmtThresholds, configs[c].thr);
+            distinctIndex(windows, configs[c].window);
+        }
+        sort(pmtThresholds.begin(), pmtThresholds.end());
+        for (size_t c = 0; c < configs.size(); c++) {
+            const TriggerConfig &config = configs[c];
+            int k = find(pmtThresholds.begin(), pmtThresholds.end(), config.thr) - pmtThresholds.begin();
+            int j = find(windows.begin(), windows.end(), config.window) - windows.begin();
+            mult.push_back(config.mult);
+            coincidenceIndex.push_back(k * windows.size() + j);
+            sipm.push_back(config.sipm);
+            sipmIndex.push_back(config.sipm > 0 ? distinctIndex(sipmThresholds, config.sipmThr) : -1);
+            vetoIndex.push_back(config.veto >= 0 ? distinctIndex(sipmThresholds, config.veto) : -1);
+        }
+        // Configurations without a SiPM condition or veto look at the always-0 slot
+        int zeroSlot = sipmThresholds.size();
+        for (size_t c = 0; c < configs.size(); c++) {
+            if (sipmIndex[c] < 0) sipmIndex[c] = zeroSlot;
+            if (vetoIndex[c] < 0) vetoIndex[c] = zeroSlot;
+        }
+        crossing.resize(pmtThresholds.size() * kNumPMTs);
+        coincidence.resize(pmtThresholds.size() * windows.size());
+        sipmCount.resize(sipmThresholds.size() + 1, 0);
+        fired.resize(configs.size());
+    }
+
+    // PMT p crosses the thresholds at sample time when its amplitude there is above them
+    void SetPMTFromWaveform(int p, const Short_t *samples, double baseline) {
+        size_t k = 0;
+        for (int s = 0; s < 45 && k < pmtThresholds.size(); s++) {
+            // The thresholds are ascending: the ones still open that this sample exceeds cross here
+            for (; k < pmtThresholds.size() && samples[s] - baseline > pmtThresholds[k]; k++) crossing[k * kNumPMTs + p] = s;
+        }
+        for (; k < pmtThresholds.size(); k++) crossing[k * kNumPMTs + p] = -1;
+    }
+
+    void SetPMTFromPulse(int p, double pulseHeight, int peakPosition) {
+        for (size_t k = 0; k < pmtThresholds.size(); k++) crossing[k * kNumPMTs + p] = (pulseHeight > pmtThresholds[k]) ? peakPosition : -1;
+    }
+
+    // amplitudes: the largest value of each SiPM
+    void SetSiPMs(const double *amplitudes) {
+        for (size_t m = 0; m < sipmThresholds.size(); m++) {
+            int count = 0;
+            for (int i = 0; i < kNumSiPMs; i++) count += amplitudes[i] > sipmThresholds[m];
+            sipmCount[m] = count;
+        }
+    }
+
+    // Evaluate every configuration; sets fired and the bits of words
+    void Evaluate(vector<ULong64_t> &words) {
+        for (size_t k = 0; k < pmtThresholds.size(); k++) {
+            int times[kNumPMTs], n = 0;
+            for (int p = 0; p < kNumPMTs; p++) {
+                int t = crossing[k * kNumPMTs + p];
+                if (t >= 0) times[n++] = t;
+            }
+            sort(times, times + n);
+            for (size_t j = 0; j < windows.size(); j++) {
+                int best = 0;
+                for (int first = 0, last = 0; first < n; first++) {
+                    while (last < n && times[last] < times[first] + windows[j]) last++;
+                    best = max(best, last - first);
+                }
+                coincidence[k * windows.size() + j] = best;
+            }
+        }
+        size_t nConfigs = fired.size();
+        for (size_t c = 0; c < nConfigs; c++) {
+            fired[c] = (coincidence[coincidenceIndex[c]] >= mult[c]) & (sipmCount[sipmIndex[c]] >= sipm[c]) &
+                       (sipmCount[vetoIndex[c]] == 0);
+        }
+        fill(words.begin(), words.end(), 0);
+        for (size_t c = 0; c < nConfigs; c++) words[c >> 6] |= (ULong64_t)fired[c] << (c & 63);
+    }
+};
+
+void triggerEmulator(const char *fileName, const char *outputName, const vector<TriggerConfig> &configs, bool usePulses,
+                     int referenceBit, EntryRange range) {
+    TFile *file = TFile::Open(fileName);
+    if (!file || file->IsZombie()) {
+        cerr << "Error opening file: " << fileName << endl;
+        return;
+    }
+    TTree *tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        cerr << "Error accessing TTree 'tree'!" << endl;
+        file->Close();
+        return;
+    }
+
+    Short_t adcVal[23][45];
+    Double_t baselineMean[23], pulseH[23];
+    Int_t peakPosition[23], triggerBits;
+    tree->SetBranchStatus("*", 0);
+    const char *branches[7] = {"adcVal", "adcPacked", "adcPackedBytes", "baselineMean", "pulseH", "peakPosition", "triggerBits"};
+    for (int b = 0; b < 7; b++) {
+        bool needed = usePulses ? (b >= 4) : (b < 4 || b == 6);
+        if (needed && tree->GetBranch(branches[b])) tree->SetBranchStatus(branches[b], 1);
+    }
+    WaveformReader *waveforms = 0;
+    if (usePulses) {
+        tree->SetBranchAddress("pulseH", pulseH);
+        tree->SetBranchAddress("peakPosition", peakPosition);
+    } else {
+        waveforms = new WaveformReader(tree, adcVal);
+        tree->SetBranchAddress("baselineMean", baselineMean);
+    }
+    tree->SetBranchAddress("triggerBits", &triggerBits);
+    CacheActiveBranches(tree);
+
+    TFile *outputFile = new TFile(outputName, "RECREATE");
+    if (!outputFile || outputFile->IsZombie()) {
+        cerr << "Error creating output file!" << endl;
+        delete waveforms;
+        file->Close();
+        return;
+    }
+
+    size_t nConfigs = configs.size();
+    int nWords = (nConfigs + 63) / 64;
+    TriggerBank bank(configs);
+    vector<ULong64_t> words(nWords);
+    TTree *emulatedTree = new TTree("emulatedTrigger", "Emulated trigger words");
+    emulatedTree->Branch("word", words.data(), TString::Format("word[%d]/l", nWords));
+
+    // Counters: events with each recorded bit, and of those the ones each configuration fires on
+    vector<Long64_t> nFired(nConfigs, 0), firedByBit(32 * nConfigs, 0);
+    Long64_t recordedByBit[32] = {0};
+    Long64_t nEvents = 0;
+
+    ClampEntryRange(range, tree->GetEntries());
+    tree->SetCacheEntryRange(range.begin, range.end);
+    for (Long64_t entry = range.begin; entry < range.end; entry++) {
+        tree->GetEntry(entry);
+        double sipmAmplitude[kNumSiPMs];
+        if (usePulses) {
+            ForEachChannel<kPMTChannel>([&](int p) {
+                bank.SetPMTFromPulse(p, pulseH[HardwareChannel(p)], peakPosition[HardwareChannel(p)]);
+            });
+            ForEachChannel<kSiPMChannel>([&](int p) { sipmAmplitude[p - kNumPMTs] = pulseH[HardwareChannel(p)]; });
+        } else {
+            if (!waveforms->Decode()) {
+                fill(words.begin(), words.end(), 0);
+                emulatedTree->Fill();
+                continue;
+            }
+            ForEachChannel<kPMTChannel>([&](int p) {
+                int ch = HardwareChannel(p);
+                bank.SetPMTFromWaveform(p, adcVal[ch], baselineMean[ch]);
+            });
+            ForEachChannel<kSiPMChannel>([&](int p) {
+                const Short_t *samples = adcVal[HardwareChannel(p)];
+                sipmAmplitude[p - kNumPMTs] = *max_element(samples, samples + 45);
+            });
+        }
+        bank.SetSiPMs(sipmAmplitude);
+        bank.Evaluate(words);
+        emulatedTree->Fill();
+
+        nEvents++;
+        for (size_t c = 0; c < nConfigs; c++) nFired[c] += bank.fired[c];
+        for (int b = 0; b < 32; b++) {
+            if (!(triggerBits & (1u << b))) continue;
+            recordedByBit[b]++;
+            Long64_t *counts = &firedByBit[b * nConfigs];
+            for (size_t c = 0; c < nConfigs; c++) counts[c] += bank.fired[c];
+        }
+    }
+
+    // One entry per configuration
+    char name[256];
+    Int_t index, mult, window, sipm;
+    Double_t thr, sipmThr, veto, efficiency, purity;
+    Long64_t fired, both, emulatedOnly, recordedOnly, firedBits[32];
+    TTree *configTree = new TTree("triggerConfigs", "Emulated trigger configurations");
+    configTree->Branch("name", name, "name/C");
+    configTree->Branch("index", &index, "index/I");
+    configTree->Branch("mult", &mult, "mult/I");
+    configTree->Branch("thr", &thr, "thr/D");
+    configTree->Branch("window", &window, "window/I");
+    configTree->Branch("sipm", &sipm, "sipm/I");
+    configTree->Branch("sipmThr", &sipmThr, "sipmThr/D");
+    configTree->Branch("veto", &veto, "veto/D");
+    configTree->Branch("fired", &fired, "fired/L");
+    configTree->Branch("firedByBit", firedBits, "firedByBit[32]/L");
+    configTree->Branch("recordedByBit", recordedByBit, "recordedByBit[32]/L");
+    configTree->Branch("both", &both, "both/L");
+    configTree->Branch("emulatedOnly", &emulatedOnly, "emulatedOnly/L");
+    configTree->Branch("recordedOnly", &recordedOnly, "recordedOnly/L");
+    configTree->Branch("efficiency", &efficiency, "efficiency/D");
+    configTree->Branch("purity", &purity, "purity/D");
+
+    cout << nEvents << " events, " << recordedByBit[referenceBit] << " with recorded bit " << referenceBit
+         << " (triggerBits " << (1u << referenceBit) << ")" << endl;
+    cout << "Configuration: fired, efficiency and purity against recorded bit " << referenceBit
+         << ", fraction fired per recorded bit" << endl;
+    for (size_t c = 0; c < nConfigs; c++) {
+        const TriggerConfig &config = configs[c];
+        strncpy(name, config.name.c_str(), sizeof(name) - 1);
+        name[sizeof(name) - 1] = 0;
+        index = c;
+        mult = config.mult;
+        thr = config.thr;
+        window = config.window;
+        sipm = config.sipm;
+        sipmThr = config.sipmThr;
+        veto = config.veto;
+        fired = nFired[c];
+        for (int b = 0; b < 32; b++) firedBits[b] = firedByBit[b * nConfigs + c];
+        both = firedBits[referenceBit];
+        emulatedOnly = fired - both;
+        recordedOnly = recordedByBit[referenceBit] - both;
+        efficiency = recordedByBit[referenceBit] ? (double)both / recordedByBit[referenceBit] : 0;
+        purity = fired ? (double)both / fired : 0;
+        configTree->Fill();
+
+        cout << name << ": " << fired << ", efficiency " << efficiency << ", purity " << purity << " |";
+        for (int b = 0; b < 32; b++) {
+            if (recordedByBit[b] > 0) cout << " bit " << b << ": " << (double)firedBits[b] / recordedByBit[b];
+        }
+        cout << endl;
+    }
+
+    outputFile->cd();
+    emulatedTree->Write();
+    configTree->Write();
+    TParameter<Int_t>("referenceBit", referenceBit).Write();
+    TParameter<Long64_t>("firstEntry", range.begin).Write();
+    outputFile->Close();
+    delete outputFile;
+    delete waveforms;
+    file->Close();
+    delete file;
+    cout << "Emulated trigger words and efficiency table written to " << outputName
+         << " (trees emulatedTrigger, triggerConfigs)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    vector<TriggerConfig> configs;
+    bool usePulses = false;
+    int referenceBit = 1; // Bit of the PMT trigger, triggerBits == 2
+    EntryRange range;
+    vector<const char*> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--trigger" && i + 1 < argc) {
+            TriggerConfig config;
+            if (!parseConfig(argv[++i], config)) {
+                cerr << "Error: invalid trigger configuration " << argv[i] << endl;
+                return 1;
+            }
+            configs.push_back(config);
+        } else if (arg == "--triggers" && i + 1 < argc) {
+            ifstream list(argv[++i]);
+            if (!list) {
+                cerr << "Error opening trigger list: " << argv[i] << endl;
+                return 1;
+            }
+            string line;
+            while (getline(list, line)) {
+                line.erase(remove(line.begin(), line.end(), ' '), line.end());
+                if (line.empty() || line[0] == '#') continue;
+                TriggerConfig config;
+                if (!parseConfig(line, config)) {
+                    cerr << "Error: invalid trigger configuration " << line << endl;
+                    return 1;
+                }
+                configs.push_back(config);
+            }
+        } else if (arg == "--source" && i + 1 < argc) {
+            usePulses = (string(argv[++i]) == "pulses");
+        } else if (arg == "--reference-bit" && i + 1 < argc) {
+            referenceBit = atoi(argv[++i]);
+        } else if (arg == "--reference-trigger" && i + 1 < argc) {
+            long value = atol(argv[++i]);
+            if (value <= 0 || value > 0x80000000L || (value & (value - 1)) != 0) {
+                cerr << "Error: --reference-trigger needs a triggerBits value with a single bit set, not " << argv[i] << endl;
+                return 1;
+            }
+            for (referenceBit = 0; (1L << referenceBit) != value; referenceBit++) {}
+        } else if (arg == "--entries" && i + 1 < argc) {
+            if (!ParseEntryRange(argv[++i], range)) {
+                cerr << "Error: invalid entry range " << argv[i] << endl;
+                return 1;
+            }
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() < 1 || args.size() > 2 || referenceBit < 0 || referenceBit > 31) {
+        cerr << "Usage: " << argv[0] << " <root_file> [trigger_emulation.root] [--trigger mult=N,thr=ADC,window=S,sipm=N,sipmthr=ADC,veto=ADC,name=X]..."
+             << " [--triggers FILE] [--source waveforms|pulses] [--reference-trigger V | --reference-bit B] [--entries begin:end]" << endl;
+        cerr << "  --reference-trigger V: recorded triggerBits value to compare with (default 2, PMT trigger); --reference-bit B: its bit index"
+             << " (default 1)" << endl;
+        return 1;
+    }
+    if (configs.empty()) {
+        // Default scan: PMT multiplicity x threshold
+        double thresholds[5] = {10, 20, 30, 50, 100};
+        for (int t = 0; t < 5; t++) {
+            for (int m = 1; m <= kNumPMTs; m++) {
+                TriggerConfig config;
+                parseConfig(TString::Format("mult=%d,thr=%g", m, thresholds[t]).Data(), config);
+                configs.push_back(config);
+            }
+        }
+    }
+    InitRunFileIO();
+    triggerEmulator(args[0], (args.size() == 2) ? args[1] : "trigger_emulation.root", configs, usePulses, referenceBit, range);
+    return 0;
+}
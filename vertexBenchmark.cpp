@@ -0,0 +1,76 @@
+//This code measures the resolution and the speed of VertexReconstructor (VertexReconstruction.h) on simulated events:
+//vertices uniform in the volume of the grid (x -1.5 - 1.5, y -2 - 2, z 0.2 - 4 PMT pitches), the charge of every PMT Poisson
+//distributed around pe x its solid-angle fraction (the model of the reconstruction, so only the photon statistics and the grid
+//limit the resolution). It prints the mean absolute and RMS error of x, y, z in pitches, of the centroid in x, y, and the time
+//per event with nThreads threads.
+//Usage: vertexBenchmark [nEvents] [pe] [nThreads]
+#include <iostream>
+#include <TRandom3.h>
+#include "DetectorGeometry.h"
+#include "VertexReconstruction.h"
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    int nEvents = (argc > 1) ? atoi(argv[1]) : 100000;
+    double pe = (argc > 2) ? atof(argv[2]) : 300;
+    int nThreads = (argc > 3) ? atoi(argv[3]) : thread::hardware_concurrency();
+    if (nEvents <= 0 || pe <= 0 || nThreads < 1) {
+        cerr << "Usage: " << argv[0] << " [nEvents] [pe] [nThreads]" << endl;
+        return 1;
+    }
+
+    // Simulated events: true vertex and the PMT charges in p.e. (mu1 = 1)
+    TRandom3 random(1);
+    vector<double> trueX(nEvents), trueY(nEvents), trueZ(nEvents);
+    vector<Double_t> areas((size_t)nEvents * kNumTreeChannels, 0.0);
+    for (int i = 0; i < nEvents; i++) {
+        trueX[i] = random.Uniform(-1.5, 1.5);
+        trueY[i] = random.Uniform(-2.0, 2.0);
+        trueZ[i] = random.Uniform(0.2, 4.0);
+        double omega[kNumPMTs], sum = 0;
+        for (int p = 0; p < kNumPMTs; p++) {
+            double dx = trueX[i] - ChannelX(p), dy = trueY[i] - ChannelY(p);
+            omega[p] = trueZ[i] / pow(dx * dx + dy * dy + trueZ[i] * trueZ[i], 1.5);
+            sum += omega[p];
+        }
+        for (int p = 0; p < kNumPMTs; p++) areas[(size_t)i * kNumTreeChannels + HardwareChannel(p)] = random.Poisson(pe * omega[p] / sum);
+    }
+    Double_t mu1[kNumPMTs];
+    for (int p = 0; p < kNumPMTs; p++) mu1[p] = 1;
+
+    VertexReconstructor vertexReco;
+    vertexReco.SetThreads(nThreads);
+    PhysicalBlock<Double_t> block;
+    VertexBlock vertices;
+    double sumAbs[5] = {0}, sum2[5] = {0};
+    double seconds = 0;
+    for (int first = 0; first < nEvents; first += block.Size()) {
+        block.Clear();
+        for (int i = first; i < nEvents && !block.Full(); i++) block.Add(&areas[(size_t)i * kNumTreeChannels]);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        vertexReco.Reconstruct(block, mu1, vertices);
+        seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        for (int i = 0; i < block.Size(); i++) {
+            double error[5] = {vertices.x[i] - trueX[first + i], vertices.y[i] - trueY[first + i], vertices.z[i] - trueZ[first + i],
+                               vertices.centroidX[i] - trueX[first + i], vertices.centroidY[i] - trueY[first + i]};
+            for (int c = 0; c < 5; c++) {
+                sumAbs[c] += fabs(error[c]);
+                sum2[c] += error[c] * error[c];
+            }
+        }
+    }
+
+    const char *names[5] = {"vertex x", "vertex y", "vertex z", "centroid x", "centroid y"};
+    cout << nEvents << " events of " << pe << " p.e., errors in PMT pitches (mean absolute / RMS):" << endl;
+    for (int c = 0; c < 5; c++) {
+        cout << "  " << names[c] << ": " << sumAbs[c] / nEvents << " / " << sqrt(sum2[c] / nEvents) << endl;
+    }
+    cout << "Reconstruction: " << 1e6 * seconds / nEvents << " us/event with " << nThreads << " threads" << endl;
+    return 0;
+}
@@ -71,12 +71,12 @@ void PlotCombinedChartAndIndividual(const char *fileName) {
 
     // Create a large font textbox on the master canvas
     masterCanvas->cd(0); // Select the canvas itself (outside the pads)
-    TLatex *textbox = new TLatex(); // Create a TLatex object for drawing text
-    textbox->SetTextSize(0.02); // Set text size
-    textbox->SetTextAlign(13);  // Align bottom-left
-    textbox->SetNDC(true);      // Use normalized device coordinates
-    textbox->DrawLatex(0.01, 0.10, "X axis: Time (0-720) ns"); // Draw the first line of text
-    textbox->DrawLatex(0.01, 0.08, "Y axis: ADC values"); // Draw the second line of text
+    TLatex textbox; // Create a TLatex object for drawing text
+    textbox.SetTextSize(0.02); // Set text size
+    textbox.SetTextAlign(13);  // Align bottom-left
+    textbox.SetNDC(true);      // Use normalized device coordinates
+    textbox.DrawLatex(0.01, 0.10, "X axis: Time (0-720) ns"); // Draw the first line of text
+    textbox.DrawLatex(0.01, 0.08, "Y axis: ADC values"); // Draw the second line of text
 
     // Plot PMTs and SiPMs at specific positions according to the layout
     for (int row = 0; row < 6; row++) { // Loop over rows
@@ -118,11 +118,11 @@ void PlotCombinedChartAndIndividual(const char *fileName) {
                 graph->Draw("AL"); // Draw the graph
 
                 // Add a custom title with larger font size using TLatex
-                TLatex *latexTitle = new TLatex(); // Create a TLatex object for the title
-                latexTitle->SetTextSize(0.10); // Set larger font size
-                latexTitle->SetTextAlign(22);  // Center alignment
-                latexTitle->SetNDC(true);      // Use normalized coordinates
-                latexTitle->DrawLatex(0.5, 0.94, title); // Draw title at the top center
+                TLatex latexTitle; // Create a TLatex object for the title
+                latexTitle.SetTextSize(0.10); // Set larger font size
+                latexTitle.SetTextAlign(22);  // Center alignment
+                latexTitle.SetNDC(true);      // Use normalized coordinates
+                latexTitle.DrawLatex(0.5, 0.94, title); // Draw title at the top center
             }
         }
     }